@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Checks the fixed-point CUBIC window target of TcpCubic against the
+ * floating point one on the same trace. With --trace, the trace is a
+ * recorded cwnd trace, e.g. the output of tcpexperiment: one sample per
+ * line, the time in seconds then the cwnd in bytes of each flow, lines
+ * starting with '#' ignored. Every cwnd decrease starts an epoch with
+ * w_last_max the cwnd before it; both targets are then computed at each
+ * sample of the epoch. Without --trace, epochs from 4 to 200000 segments
+ * are swept at 1 ms steps.
+ *
+ * Exits with status 1 if the targets differ by more than 2 segments and
+ * 1% of the floating point target.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include "ns3/core-module.h"
+#include "ns3/tcp-cubic.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("CubicFixedPointCheck");
+
+/* Largest difference between the two targets, absolute and over the bound */
+struct Difference
+{
+  Difference () : samples (0), maxAbs (0.0), maxRatio (0.0) {}
+
+  uint64_t samples;
+  double maxAbs;
+  double maxRatio;
+};
+
+/* Compare the targets of an epoch at t seconds after its start */
+static void
+Compare (Difference &d, uint32_t wLastMax, uint32_t cWnd, double c, double t)
+{
+  uint32_t scale = std::max (1u, static_cast<uint32_t> (c * 1024 + 0.5));
+  double k = TcpCubic::CubicK (wLastMax - cWnd, c);
+  uint32_t kFixed = TcpCubic::CubicKFixed (wLastMax - cWnd, scale);
+  // Rounded to whole microseconds first, as TcpCubic does
+  uint64_t tFixed = (static_cast<uint64_t> (t * 1e6 + 0.5) << 10) / 1000000;
+
+  double target = std::max (TcpCubic::CubicTarget (t, k, c, wLastMax), 0.0);
+  double fixed = TcpCubic::CubicTargetFixed (tFixed, kFixed, scale, wLastMax);
+  double diff = std::fabs (fixed - target);
+  d.samples++;
+  d.maxAbs = std::max (d.maxAbs, diff);
+  d.maxRatio = std::max (d.maxRatio, diff / std::max (2.0, 0.01 * target));
+}
+
+static void
+CheckTrace (Difference &d, const std::string &file, uint32_t column, uint32_t segSize, double c)
+{
+  std::ifstream in (file.c_str ());
+  NS_ABORT_MSG_UNLESS (in, "Cannot open " << file);
+  std::string line;
+  uint32_t last = 0;
+  uint32_t wLastMax = 0;
+  uint32_t epochCwnd = 0;
+  double epochStart = -1.0;
+  while (std::getline (in, line))
+    {
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      std::istringstream fields (line);
+      double time;
+      uint32_t cwnd = 0;
+      fields >> time;
+      for (uint32_t i = 0; i < column; ++i)
+        {
+          fields >> cwnd;
+        }
+      if (!fields)
+        {
+          continue;
+        }
+      uint32_t w = cwnd / segSize;
+      if (w < last)
+        { // Loss: a new epoch starts from the reduced window
+          wLastMax = last;
+          epochCwnd = w;
+          epochStart = time;
+        }
+      last = w;
+      if (epochStart >= 0.0 && wLastMax > epochCwnd)
+        {
+          Compare (d, wLastMax, epochCwnd, c, time - epochStart);
+        }
+    }
+}
+
+static void
+CheckSweep (Difference &d, double beta, double c)
+{
+  for (uint32_t w = 4; w <= 200000; w = w * 11 / 10 + 1)
+    {
+      uint32_t cWnd = static_cast<uint32_t> (w * (1.0 - beta));
+      if (cWnd == w)
+        {
+          continue;
+        }
+      double end = std::max (3.0 * TcpCubic::CubicK (w - cWnd, c), 5.0);
+      for (double t = 0.0; t <= end; t += 0.001)
+        {
+          Compare (d, w, cWnd, c, t);
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string trace = "";
+  uint32_t column = 1;
+  uint32_t segSize = 536;
+  double c = 0.4;
+  double beta = 0.2;
+
+  CommandLine cmd;
+  cmd.AddValue ("trace", "Recorded cwnd trace, empty to sweep synthetic epochs", trace);
+  cmd.AddValue ("column", "Column of the cwnd in the trace, after the time", column);
+  cmd.AddValue ("segSize", "Segment size of the trace, in bytes", segSize);
+  cmd.AddValue ("c", "CUBIC constant, as the TcpCubic C attribute", c);
+  cmd.AddValue ("beta", "Reduction of the synthetic epochs, as the TcpCubic Beta attribute", beta);
+  cmd.Parse (argc, argv);
+
+  Difference d;
+  if (trace.empty ())
+    {
+      CheckSweep (d, beta, c);
+    }
+  else
+    {
+      CheckTrace (d, trace, column, segSize, c);
+    }
+
+  std::cout << "samples\t" << d.samples << std::endl
+            << "max difference (segments)\t" << d.maxAbs << std::endl
+            << "max difference / bound\t" << d.maxRatio << std::endl;
+  if (d.maxRatio > 1.0)
+    {
+      std::cout << "FAIL: fixed-point target off by more than max (2 segments, 1%)" << std::endl;
+      return 1;
+    }
+  std::cout << "PASS" << std::endl;
+  return 0;
+}
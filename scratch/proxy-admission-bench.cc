@@ -0,0 +1,205 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Micro-benchmark of the admission lookup TcpProxy does on every SYN.
+ * Rules over /16, /24 and /32 prefixes of 10.0.0.0/8, each with a range
+ * of source ports, are looked up for random clients. The
+ * Ipv4AdmissionTable is compared with a scan of all the rules, which
+ * gives the same answers, and with the std::map keyed by exact address
+ * TcpProxy used to have, which cannot express prefixes nor ports.
+ */
+
+#include <map>
+#include <set>
+#include <vector>
+#include <ctime>
+#include <cstdlib>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/ipv4-admission-table.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("ProxyAdmissionBench");
+
+struct Rule
+{
+  Ipv4Address network;
+  Ipv4Mask mask;
+  uint16_t portLow;
+  uint16_t portHigh;
+  Address destination;
+};
+
+/* Longest prefix over all the rules */
+class LinearTable
+{
+public:
+  void Add (const Rule &rule)
+  {
+    m_rules.push_back (rule);
+  }
+  bool Lookup (Ipv4Address address, uint16_t port, Address &destination) const
+  {
+    int best = -1;
+    for (uint32_t i = 0; i < m_rules.size (); ++i)
+      {
+        const Rule &r = m_rules[i];
+        if (r.mask.IsMatch (address, r.network) && r.portLow <= port && port <= r.portHigh
+            && (best < 0 || r.mask.GetPrefixLength () > m_rules[best].mask.GetPrefixLength ()))
+          {
+            best = i;
+          }
+      }
+    if (best < 0)
+      {
+        return false;
+      }
+    destination = m_rules[best].destination;
+    return true;
+  }
+private:
+  std::vector<Rule> m_rules;
+};
+
+/* The exact address map TcpProxy used to have, ports ignored */
+class MapTable
+{
+public:
+  void Add (const Rule &rule)
+  {
+    m_map[rule.network] = rule.destination;
+  }
+  bool Lookup (Ipv4Address address, uint16_t port, Address &destination) const
+  {
+    std::map<Address, Address>::const_iterator i = m_map.find (address);
+    if (i == m_map.end ())
+      {
+        return false;
+      }
+    destination = i->second;
+    return true;
+  }
+private:
+  std::map<Address, Address> m_map;
+};
+
+/* Random client within the prefixes the rules use */
+static Ipv4Address
+RandomClient (void)
+{
+  return Ipv4Address (0x0a000000 | ((std::rand () & 0x3f) << 16) | (std::rand () & 0xffff));
+}
+
+static std::vector<Rule>
+MakeRules (uint32_t n)
+{
+  static const char *masks[] = {"/16", "/24", "/32"};
+  std::vector<Rule> rules;
+  std::set<uint64_t> used;
+  std::srand (1);
+  while (rules.size () < n)
+    {
+      Rule rule;
+      rule.mask = Ipv4Mask (masks[std::rand () % 3]);
+      rule.network = RandomClient ().CombineMask (rule.mask);
+      // One of 16 port ranges, not overlapping those of the same prefix
+      uint32_t slot = std::rand () % 16;
+      uint64_t key = (static_cast<uint64_t> (rule.network.Get ()) << 12)
+        | (rule.mask.GetPrefixLength () << 4) | slot;
+      if (!used.insert (key).second)
+        {
+          continue;
+        }
+      rule.portLow = slot * 4096;
+      rule.portHigh = rule.portLow + 4095;
+      rule.destination = InetSocketAddress (Ipv4Address (0x0b000000 + rules.size ()), 9);
+      rules.push_back (rule);
+    }
+  return rules;
+}
+
+template <typename T>
+static double
+Run (const T &table, uint32_t lookups, uint32_t *admitted)
+{
+  std::srand (2);
+  Address destination;
+  *admitted = 0;
+  std::clock_t start = std::clock ();
+  for (uint32_t i = 0; i < lookups; ++i)
+    {
+      *admitted += table.Lookup (RandomClient (), std::rand () & 0xffff, destination);
+    }
+  return static_cast<double> (std::clock () - start) / CLOCKS_PER_SEC / lookups * 1e9;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t rules = 10000;
+  uint32_t lookups = 1000000;
+  uint32_t check = 10000;
+
+  CommandLine cmd;
+  cmd.AddValue ("rules", "Number of admission rules", rules);
+  cmd.AddValue ("lookups", "Number of lookups timed per structure", lookups);
+  cmd.AddValue ("check", "Lookups compared between the table and the scan", check);
+  cmd.Parse (argc, argv);
+
+  std::vector<Rule> set = MakeRules (rules);
+  LinearTable linear;
+  MapTable map;
+  Ipv4AdmissionTable table;
+  for (uint32_t i = 0; i < set.size (); ++i)
+    {
+      linear.Add (set[i]);
+      map.Add (set[i]);
+      table.Add (set[i].network, set[i].mask, set[i].portLow, set[i].portHigh, set[i].destination);
+    }
+  std::clock_t start = std::clock ();
+  table.Build ();
+  double build = static_cast<double> (std::clock () - start) / CLOCKS_PER_SEC * 1e3;
+
+  std::srand (3);
+  for (uint32_t i = 0; i < check; ++i)
+    {
+      Ipv4Address client = RandomClient ();
+      uint16_t port = std::rand () & 0xffff;
+      Address a;
+      Address b;
+      bool found = linear.Lookup (client, port, a);
+      NS_ABORT_MSG_UNLESS (table.Lookup (client, port, b) == found && (!found || a == b),
+                           "Mismatch for " << client << ":" << port);
+    }
+
+  // The scan is linear in the rules, keep its run bounded
+  uint32_t linearLookups = std::max (1u, std::min (lookups, 1000000000u / rules));
+  uint32_t linearAdmitted;
+  uint32_t mapAdmitted;
+  uint32_t tableAdmitted;
+  double linearNs = Run (linear, linearLookups, &linearAdmitted);
+  double mapNs = Run (map, lookups, &mapAdmitted);
+  double tableNs = Run (table, lookups, &tableAdmitted);
+
+  std::cout << "# " << rules << " rules, table built in " << build << " ms" << std::endl;
+  std::cout << "# structure\tns/lookup\tadmitted" << std::endl;
+  std::cout << "scan\t" << linearNs << "\t" << linearAdmitted << "/" << linearLookups << std::endl;
+  std::cout << "map (exact)\t" << mapNs << "\t" << mapAdmitted << "/" << lookups << std::endl;
+  std::cout << "table\t" << tableNs << "\t" << tableAdmitted << "/" << lookups << std::endl;
+  return 0;
+}
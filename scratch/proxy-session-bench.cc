@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Micro-benchmark of the socket pair lookup TcpProxy does on every
+ * receive and send callback, under connection churn. A number of
+ * connections are kept open; each round closes the oldest one, opens a
+ * new one and delivers callbacks on random legs of the open ones. The
+ * std::map keyed by socket with parallel vectors TcpProxy used to have,
+ * which never forgets a connection, is compared with sessions the
+ * sockets point to, as in tcpexperiment's ProxySession.
+ */
+
+#include <list>
+#include <map>
+#include <vector>
+#include <ctime>
+#include <cstdlib>
+#include "ns3/core-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("ProxySessionBench");
+
+class Session;
+
+/* Stands for a socket: what matters is the identity and the session */
+class Leg : public SimpleRefCount<Leg>
+{
+public:
+  Leg () : session (0) {}
+  Session *session;
+};
+
+class Session
+{
+public:
+  Session () : iLeg (Create<Leg> ()), oLeg (Create<Leg> ())
+  {
+    iLeg->session = this;
+    oLeg->session = this;
+  }
+  Ptr<Leg> GetPeer (Ptr<Leg> leg) const
+  {
+    return leg == iLeg ? oLeg : iLeg;
+  }
+  Ptr<Leg> iLeg;
+  Ptr<Leg> oLeg;
+};
+
+/* The lookup TcpProxy used to do */
+class MapProxy
+{
+public:
+  void Open (Ptr<Leg> iLeg, Ptr<Leg> oLeg)
+  {
+    m_map[oLeg] = m_oSockets.size ();
+    m_map[iLeg] = m_iSockets.size ();
+    m_oSockets.push_back (oLeg);
+    m_iSockets.push_back (iLeg);
+  }
+  void Close (Ptr<Leg> iLeg, Ptr<Leg> oLeg)
+  { // Entries were never removed
+  }
+  Ptr<Leg> GetPeer (Ptr<Leg> leg)
+  {
+    NS_ABORT_MSG_UNLESS (m_map.find (leg) != m_map.end (), "Unmapped socket");
+    Ptr<Leg> iLeg = m_iSockets[m_map[leg]];
+    Ptr<Leg> oLeg = m_oSockets[m_map[leg]];
+    return leg == iLeg ? oLeg : iLeg;
+  }
+  uint32_t GetEntries (void) const
+  {
+    return m_map.size ();
+  }
+private:
+  std::vector<Ptr<Leg> > m_iSockets;
+  std::vector<Ptr<Leg> > m_oSockets;
+  std::map<Ptr<Leg>, int> m_map;
+};
+
+/* Sessions bound to their sockets */
+class SessionProxy
+{
+public:
+  SessionProxy () : m_sessions (0) {}
+  void Open (Ptr<Leg> iLeg, Ptr<Leg> oLeg)
+  {
+    m_sessions++;
+  }
+  void Close (Ptr<Leg> iLeg, Ptr<Leg> oLeg)
+  {
+    m_sessions--;
+  }
+  Ptr<Leg> GetPeer (Ptr<Leg> leg)
+  {
+    return leg->session->GetPeer (leg);
+  }
+  uint32_t GetEntries (void) const
+  {
+    return 2 * m_sessions;
+  }
+private:
+  uint32_t m_sessions;
+};
+
+template <typename T>
+static double
+Run (uint32_t concurrent, uint32_t rounds, uint32_t callbacks, uint32_t *entries)
+{
+  T proxy;
+  std::vector<Session *> open;
+  std::srand (1);
+  for (uint32_t i = 0; i < concurrent; ++i)
+    {
+      open.push_back (new Session ());
+      proxy.Open (open.back ()->iLeg, open.back ()->oLeg);
+    }
+
+  uint32_t oldest = 0;
+  uint32_t found = 0;
+  std::clock_t start = std::clock ();
+  for (uint32_t r = 0; r < rounds; ++r)
+    {
+      Session *s = open[oldest];
+      proxy.Close (s->iLeg, s->oLeg);
+      delete s;
+      open[oldest] = new Session ();
+      proxy.Open (open[oldest]->iLeg, open[oldest]->oLeg);
+      oldest = (oldest + 1) % concurrent;
+      for (uint32_t c = 0; c < callbacks; ++c)
+        {
+          Session *t = open[std::rand () % concurrent];
+          Ptr<Leg> leg = (c & 1) ? t->iLeg : t->oLeg;
+          found += proxy.GetPeer (leg) != leg;
+        }
+    }
+  double ns = static_cast<double> (std::clock () - start) / CLOCKS_PER_SEC / rounds / callbacks * 1e9;
+  NS_ASSERT (found == rounds * callbacks);
+  *entries = proxy.GetEntries ();
+  for (uint32_t i = 0; i < concurrent; ++i)
+    {
+      delete open[i];
+    }
+  return ns;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t rounds = 100000;
+  uint32_t callbacks = 20;
+  uint32_t maxConcurrent = 10000;
+
+  CommandLine cmd;
+  cmd.AddValue ("rounds", "Connections opened and closed per test", rounds);
+  cmd.AddValue ("callbacks", "Socket callbacks between two connection changes", callbacks);
+  cmd.AddValue ("maxConcurrent", "Largest number of open connections to test", maxConcurrent);
+  cmd.Parse (argc, argv);
+
+  std::cout << "# open\tmap (ns/callback)\tentries\tsession (ns/callback)\tentries" << std::endl;
+  for (uint32_t concurrent = 10; concurrent <= maxConcurrent; concurrent *= 10)
+    {
+      uint32_t mapEntries;
+      uint32_t sessionEntries;
+      double map = Run<MapProxy> (concurrent, rounds, callbacks, &mapEntries);
+      double session = Run<SessionProxy> (concurrent, rounds, callbacks, &sessionEntries);
+      std::cout << concurrent << "\t" << map << "\t" << mapEntries
+                << "\t" << session << "\t" << sessionEntries << std::endl;
+    }
+  return 0;
+}
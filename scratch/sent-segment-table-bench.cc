@@ -0,0 +1,150 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Micro-benchmark of the per-segment send bookkeeping. A window of
+ * segments is kept outstanding and each ACK performs the lookups
+ * TcpNewVegas makes, discards up to the ACK and sends one more segment.
+ * The TcpSentSegmentTable ring is compared with the linear-scan
+ * std::list VegasList used to be.
+ */
+
+#include <list>
+#include <ctime>
+#include "ns3/core-module.h"
+#include "ns3/tcp-sent-segment-table.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SentSegmentTableBench");
+
+/* The std::list based implementation VegasList used to have */
+class LinearVegasList
+{
+public:
+  struct Node
+  {
+    SequenceNumber32 seq;
+    Time sentTime;
+    uint32_t bytes;
+  };
+
+  void Sent (SequenceNumber32 seq, uint32_t size)
+  {
+    Node node = { seq + SequenceNumber32 (size), Simulator::Now (), 0 };
+    m_data.push_back (node);
+    for (std::list<Node>::iterator i = m_data.begin (); i != m_data.end (); i++)
+      (*i).bytes += size;
+  }
+  void DiscardUpTo (SequenceNumber32 seq)
+  {
+    std::list<Node>::iterator i = m_data.begin ();
+    while (i != m_data.end ())
+      if ((*i).seq <= seq)
+        i = m_data.erase (i);
+      else
+        i++;
+  }
+  Node GetFirstNode (SequenceNumber32 seq)
+  {
+    std::list<Node>::iterator i = m_data.begin ();
+    while (i != m_data.end ())
+      if ((*i).seq == seq)
+        return *i;
+      else
+        i++;
+    return Node ();
+  }
+  Node GetLastNode (SequenceNumber32 seq)
+  {
+    Node node = Node ();
+    for (std::list<Node>::iterator i = m_data.begin (); i != m_data.end (); i++)
+      if ((*i).seq == seq)
+        node = *i;
+    return node;
+  }
+private:
+  std::list<Node> m_data;
+};
+
+static void
+Lookup (LinearVegasList& list, SequenceNumber32 ack)
+{
+  list.GetFirstNode (ack);
+  list.GetLastNode (ack);
+}
+
+static void
+Lookup (TcpSentSegmentTable& table, SequenceNumber32 ack)
+{
+  uint32_t i = table.Find (ack);
+  if (i < table.Size ())
+    {
+      table.GetFirstSentTime (i);
+      table.GetSentTime (i);
+      table.GetBytesSentSnapshot (i);
+    }
+}
+
+template <typename T>
+static double
+Run (uint32_t window, uint32_t acks, uint32_t segSize)
+{
+  T list;
+  SequenceNumber32 next (0);
+  for (uint32_t i = 0; i < window; ++i)
+    {
+      list.Sent (next, segSize);
+      next += segSize;
+    }
+
+  SequenceNumber32 ack (0);
+  std::clock_t start = std::clock ();
+  for (uint32_t i = 0; i < acks; ++i)
+    {
+      ack += segSize;
+      Lookup (list, ack);
+      list.DiscardUpTo (ack);
+      list.Sent (next, segSize);
+      next += segSize;
+    }
+  return static_cast<double> (std::clock () - start) / CLOCKS_PER_SEC / acks * 1e9;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t acks = 100000;
+  uint32_t segSize = 536;
+  uint32_t maxWindow = 100000;
+
+  CommandLine cmd;
+  cmd.AddValue ("acks", "Number of ACKs processed per window size", acks);
+  cmd.AddValue ("segSize", "Segment size, in bytes", segSize);
+  cmd.AddValue ("maxWindow", "Largest window to test, in segments", maxWindow);
+  cmd.Parse (argc, argv);
+
+  std::cout << "# window\tlist (ns/ack)\ttable (ns/ack)" << std::endl;
+  for (uint32_t window = 10; window <= maxWindow; window *= 10)
+    {
+      // The linear list is quadratic in the window, keep its run bounded
+      uint32_t listAcks = std::max (1u, std::min (acks, 100000000u / window / window));
+      double list = Run<LinearVegasList> (window, listAcks, segSize);
+      double table = Run<TcpSentSegmentTable> (window, acks, segSize);
+      std::cout << window << "\t" << list << "\t" << table << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Simulation cost of a bulk transfer over one fast point-to-point link,
+ * with the sender sending segment by segment and with bursts of the
+ * TcpSocketBase OffloadSize. Reports the wall clock time per transferred
+ * GB for each burst size.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpOffloadBench");
+
+/* Wall clock milliseconds to transfer the data, and the bytes received */
+static int64_t
+Run (uint32_t offloadSize, uint32_t data, std::string rate, uint32_t *received)
+{
+  Config::SetDefault ("ns3::TcpSocketBase::OffloadSize", UintegerValue (offloadSize));
+
+  NodeContainer nodes;
+  nodes.Create (2);
+  PointToPointHelper link;
+  link.SetDeviceAttribute ("DataRate", StringValue (rate));
+  link.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  NetDeviceContainer devices = link.Install (nodes);
+
+  InternetStackHelper stack;
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  uint16_t port = 9;
+  TcpSendHelper sender ("ns3::TcpSocketFactory", InetSocketAddress (interfaces.GetAddress (1), port));
+  sender.SetAttribute ("MaxBytes", UintegerValue (data));
+  sender.Install (nodes.Get (0)).Start (Seconds (0));
+  PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", InetSocketAddress (interfaces.GetAddress (1), port));
+  ApplicationContainer sink = sinkHelper.Install (nodes.Get (1));
+  sink.Start (Seconds (0));
+
+  SystemWallClockMs wallClock;
+  wallClock.Start ();
+  Simulator::Run ();
+  int64_t elapsed = wallClock.End ();
+  *received = DynamicCast<PacketSink> (sink.Get (0))->GetTotalRx ();
+  Simulator::Destroy ();
+  return elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t data = 268435456;
+  uint32_t window = 1048576;
+  std::string rate = "1Gbps";
+  uint32_t maxOffload = 65536;
+
+  CommandLine cmd;
+  cmd.AddValue ("data", "Bytes transferred per run", data);
+  cmd.AddValue ("window", "Socket buffers and max advertised window, in bytes", window);
+  cmd.AddValue ("rate", "Data rate of the link", rate);
+  cmd.AddValue ("maxOffload", "Largest burst size to test, in bytes", maxOffload);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (window));
+  Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue (window));
+  Config::SetDefault ("ns3::TcpSocketBase::MaxWindowSize", UintegerValue (window));
+
+  std::cout << "# offload (bytes)\twall clock (ms)\tms/GB\treceived" << std::endl;
+  for (uint32_t offloadSize = 0; offloadSize <= maxOffload; offloadSize = offloadSize ? 4 * offloadSize : 4096)
+    {
+      uint32_t received;
+      int64_t elapsed = Run (offloadSize, data, rate, &received);
+      std::cout << offloadSize << "\t" << elapsed << "\t"
+                << (received > 0 ? elapsed * 1073741824.0 / received : 0.0)
+                << "\t" << received << std::endl;
+    }
+  return 0;
+}
@@ -14,11 +14,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <fstream>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/ipv4-admission-table.h"
 
 // Default Network Topology
 //
@@ -29,6 +32,10 @@
 //                   point-to-point    point-to-point  |    |    |    |
 //                                                     ================
 //                                                       LAN 10.3.X.0
+//
+// With --hops=N, N - 1 routers (n7, ...) lie between n6 and n8, linked
+// over 10.2.K.0. --proxyAt places a proxy on any of the routers of the
+// path, by position: 0 for n6, 1 for n7 and so on, N for n8.
 
 using namespace ns3;
 
@@ -36,6 +43,161 @@ NS_LOG_COMPONENT_DEFINE ("TcpExperiment");
 
 /* * * * * * * * * * * * * START OF TcpProxy CLASS * * * * * * * * * * * * */
 
+class TcpProxy;
+
+/* Non-empty bins of a histogram, as " start: count" */
+static std::string
+HistogramString (Histogram &h)
+{
+  std::ostringstream os;
+  for (uint32_t i = 0; i < h.GetNBins (); ++i)
+    {
+      if (h.GetBinCount (i) > 0)
+        {
+          os << " " << h.GetBinStart (i) << ": " << h.GetBinCount (i);
+        }
+    }
+  return os.str ();
+}
+
+/**
+ * Telemetry of a proxied connection. Directions are indexed by their
+ * receiving leg: 0 from the client to the server, 1 the other way.
+ *
+ * A direction stalled on send (data received, no room in the send
+ * buffer of the other leg) is limited by the leg it sends on; one
+ * stalled on receive (nothing to forward) is limited by the leg it
+ * receives on, or by the application behind it.
+ */
+struct ProxySessionStats
+{
+  ProxySessionStats () : id (0)
+  {
+    bytes[0] = bytes[1] = 0;
+    peakBuffered[0] = peakBuffered[1] = 0;
+  }
+  uint32_t id;              //!< Number of the session in its proxy
+  Address destination;      //!< Server the session connects to
+  Time start;               //!< Time the client was accepted
+  Time end;                 //!< Time the session was closed, or of the snapshot
+  uint64_t bytes[2];        //!< Bytes forwarded
+  Time sendStall[2];        //!< Time with data to forward and a full send buffer
+  Time recvStall[2];        //!< Time with nothing to forward, before the FIN
+  uint64_t peakBuffered[2]; //!< Largest backlog held in the proxy, bytes
+};
+
+/**
+ * A proxied connection: the socket accepted from the client and the one
+ * opened to the server. The callbacks of both sockets are bound to their
+ * session, so an event on one leg reaches the other without a lookup.
+ *
+ * The session follows the TCP state of both legs. A FIN on one leg is
+ * passed on as ShutdownSend () on the other once the data received
+ * before it has been forwarded; a reset on one leg aborts the other.
+ * Once both legs are closed (CLOSED or TIME_WAIT), the session unbinds
+ * the callbacks and the proxy drops it, along with its references to
+ * the sockets and their buffers.
+ *
+ * Until the server leg is established, the data of the client is read
+ * into a staging buffer, up to the proxy's EarlyDataLimit, and sent as
+ * soon as the connection succeeds. If it fails, the client leg is reset.
+ *
+ * For each direction, the session follows the bytes received on one leg
+ * and those that left the send buffer of the other. The difference is
+ * the backlog held in the proxy; the times the bytes arrived give their
+ * sojourn time. With back-pressure, the window of the receiving leg is
+ * capped so that the backlog stays under what the sending leg drains in
+ * the proxy's BackPressureDelay.
+ *
+ * With the proxy's Coalesce attribute, the socket callbacks only mark
+ * their direction, and a single event at the end of the time step
+ * forwards in each marked direction: one Send () per direction instead
+ * of one per callback.
+ *
+ * The session also keeps the ProxySessionStats of each direction: the
+ * state of the legs is sampled on every event, and holds until the next.
+ */
+class ProxySession : public SimpleRefCount<ProxySession>
+{
+public:
+  ProxySession (TcpProxy *proxy, Ptr<Socket> iSocket, Ptr<Socket> oSocket, const Address &destination);
+
+  /**
+   * \brief Bind the callbacks of both legs to the session
+   * \param connected the server leg is already established (from the pool)
+   */
+  void Start (bool connected);
+  void Release (void); //!< Unbind the callbacks, the session can be freed
+
+  /**
+   * \param socket one leg of the session
+   * \returns the other leg
+   */
+  Ptr<Socket> GetPeer (Ptr<Socket> socket) const;
+
+  /**
+   * \returns the telemetry of the session so far
+   */
+  ProxySessionStats GetStats (void) const;
+
+  std::list<Ptr<ProxySession> >::iterator m_self; //!< Position in the proxy's session list
+
+private:
+  void HandleRecv (Ptr<Socket> socket);
+  void HandleConnected (Ptr<Socket> socket);
+  void HandleConnectFailed (Ptr<Socket> socket);
+  void Stage (void);           //!< Read client data while the server leg is connecting
+  void Pass (int leg);         //!< Forward the data received on a leg, now or coalesced
+  void Flush (void);           //!< Forward in the directions that had events in this time step
+  void HandleSend (Ptr<Socket> socket, uint32_t bytesSent);
+  void HandleIState (TcpStates_t oldState, TcpStates_t newState);
+  void HandleOState (TcpStates_t oldState, TcpStates_t newState);
+  void HandleState (int leg, TcpStates_t oldState, TcpStates_t newState);
+  void Propagate (int leg);    //!< Pass on the FIN received on a leg once its data is forwarded
+  void Account (void);         //!< Update the memory, backlog and drain rate accounting
+  void Measure (int leg);      //!< Sample the flow received on a leg and forwarded to the other
+  uint32_t GetClientWindowCap (void);
+  uint32_t GetServerWindowCap (void);
+  uint32_t WindowCap (int leg); //!< Back-pressure bound on the window of a leg
+
+  TcpProxy *m_proxy;     //!< Proxy the session belongs to
+  Ptr<Socket> m_legs[2]; //!< Client leg (accepted), server leg (opened by the proxy)
+  uint32_t m_sndBuf[2];  //!< Send buffer size of each leg
+  bool m_finished[2];    //!< The peer of the leg sent its FIN
+  bool m_shutdown[2];    //!< The leg was shut down for sending
+  bool m_closed[2];      //!< The leg is closed
+  uint64_t m_memory;     //!< Memory last reported to the proxy
+  bool m_released;       //!< Removal from the proxy is scheduled
+  bool m_connecting;     //!< The server leg is not established yet
+  Ptr<Packet> m_staged;  //!< Client data read while connecting
+  uint32_t m_stageLimit; //!< Most bytes staged while connecting
+  uint32_t m_segSize[2]; //!< Segment size of each leg
+  bool m_pending[2];     //!< Data received on the leg waits for the flush
+  EventId m_flushEvent;  //!< Coalesced forwarding of this time step
+  ProxySessionStats m_stats; //!< Telemetry, byte counts aside
+
+  /// One direction of the session, by receiving leg
+  struct Flow
+  {
+    Flow () : written (0), received (0), drained (0), rate (0), advertised (0),
+              sendStalled (false), recvStalled (false) {}
+    uint64_t written;    //!< Bytes written into the sending leg
+    uint64_t received;   //!< Bytes received by the receiving leg
+    uint64_t drained;    //!< Bytes that left the send buffer of the sending leg
+    double rate;         //!< Drain rate, bytes/s (moving average)
+    Time lastDrain;      //!< Time of the last drain rate sample
+    uint32_t advertised; //!< Last window cap given to the receiving leg
+    std::deque<std::pair<uint64_t, Time> > arrivals; //!< Received byte count and time, not drained yet
+    Time lastSample;     //!< Time of the last sample
+    bool sendStalled;    //!< The sending leg had no room at the last sample
+    bool recvStalled;    //!< The receiving leg had nothing at the last sample
+  };
+  Flow m_flows[2];
+  Histogram m_occupancy; //!< Bytes held in the proxy, sampled on every event
+  Histogram m_sojourn;   //!< Seconds from reception to leaving the proxy
+};
+
+
 class TcpProxy : public Application
 {
 public:
@@ -46,28 +208,483 @@ public:
   virtual ~TcpProxy ();
   
   virtual void AddPair (const Address srcip, uint16_t srcport, const Address dstip, uint16_t dstport);
+  /**
+   * \brief Admit the clients from a prefix and range of source ports
+   *
+   * Among the rules matching a client, the one with the longest prefix
+   * applies. The rules are sorted when the proxy starts.
+   *
+   * \param network client prefix
+   * \param mask client prefix mask
+   * \param portLow first source port
+   * \param portHigh last source port
+   * \param destination address and port to connect the clients to
+   */
+  virtual void AddRule (Ipv4Address network, Ipv4Mask mask, uint16_t portLow, uint16_t portHigh,
+                        const Address destination);
+  /**
+   * \brief Send the connections to a prefix of destinations through another proxy
+   *
+   * The next proxy, which must know this one as an upstream, is told the
+   * destination of each connection in a header sent before the data.
+   * Without a matching route, the proxy connects to the destination.
+   *
+   * \param network destination prefix
+   * \param mask destination prefix mask
+   * \param nextHop address and port of the next proxy
+   */
+  virtual void AddRoute (Ipv4Address network, Ipv4Mask mask, const Address nextHop);
+  /**
+   * \brief Accept the connections of a proxy chained in front of this one
+   * \param ip address the previous proxy connects from
+   */
+  virtual void AddUpstream (const Address ip);
   virtual void SetPort (uint16_t port);
+  uint64_t GetForwardedBytes (void) const;
+  uint64_t GetForwardCalls (void) const;
+  uint64_t GetSendCalls (void) const;
+  uint32_t GetLiveSessions (void) const;
+  uint64_t GetPeakMemory (void) const;
+  uint32_t GetPoolHits (void) const;
+  uint32_t GetPoolMisses (void) const;
+  Histogram &GetOccupancyHistogram (void);
+  Histogram &GetSojournHistogram (void);
+  /**
+   * \brief Write the telemetry of the closed and open sessions to TelemetryFile
+   *
+   * Done on stop; call it before Simulator::Destroy () when the simulation
+   * may end before the proxy stops.
+   */
+  void FlushTelemetry (void);
   
 protected:
   virtual void DoDispose (void);
   virtual bool HandleRequest (Ptr<Socket> socket, const Address &address);
   virtual void HandleConnectionCreated (Ptr<Socket> socket, const Address &address);
-  virtual void HandleRecv (Ptr<Socket> socket);
-  virtual void HandleSend (Ptr<Socket> socket, uint32_t bytesSent);
-  virtual void Forward (Ptr<Socket> src, Ptr<Socket> dst);
+  virtual void HandleChainHeader (Ptr<Socket> socket);
+  virtual void OpenSession (Ptr<Socket> socket, InetSocketAddress destination);
+  virtual void SendChainHeader (Ptr<Socket> socket, InetSocketAddress destination);
+  virtual bool LookupRoute (Ipv4Address destination, Address &nextHop) const;
+  virtual uint32_t Forward (Ptr<Socket> src, Ptr<Socket> dst);
+  virtual void RemoveSession (Ptr<ProxySession> session);
+  virtual void UpdateMemory (int64_t delta);
+  virtual Ptr<Socket> CreateTcpSocket (const std::string &type);
+  virtual void FillPool (Address server);
+  virtual void HandlePoolConnected (Ptr<Socket> socket);
+  virtual void HandlePoolConnectFailed (Ptr<Socket> socket);
+  virtual void HandlePoolClose (Ptr<Socket> socket);
+  virtual void ClosePool (void);
+  virtual void WriteTelemetry (const std::vector<ProxySessionStats> &stats) const;
 
 private:
   virtual void StartApplication (void);
   virtual void StopApplication (void);
   
+  friend class ProxySession;
+
   uint16_t m_port;                      //!< Listening port
   Ptr<Socket> m_socket;                 //!< Listener socket
-  std::vector<Ptr<Socket> > m_iSockets; //!< input sockets
-  std::vector<Ptr<Socket> > m_oSockets; //!< output sockets
-  std::map<Ptr<Socket>, int> m_map;     //!< maps sockets to their indices
-  std::map<Address, Address> m_pair;    //!< maps addresses to their pair
+  std::list<Ptr<ProxySession> > m_sessions; //!< open sessions
+  Ipv4AdmissionTable m_admission;       //!< admitted clients and their destinations
+
+  /// Next proxy for the destinations in a prefix
+  struct Route
+  {
+    Ipv4Address network;
+    Ipv4Mask mask;
+    Address nextHop;
+  };
+  std::vector<Route> m_routes;          //!< routes, longest prefixes first
+  std::set<Address> m_upstreams;        //!< addresses of the previous proxies of chains
+  static const uint32_t CHAIN_HEADER_SIZE = 6; //!< destination IPv4 address and port
+  bool m_splice;                        //!< forward with TcpSocketBase::SpliceTo
+  bool m_coalesce;                      //!< forward once per time step and session
+  uint64_t m_forwardCalls;              //!< Forward () invocations
+  uint64_t m_sendCalls;                 //!< Send () or SpliceTo () calls
+  std::string m_clientSocketType;       //!< TCP variant of the client legs, empty for the default
+  std::string m_serverSocketType;       //!< TCP variant of the server legs, empty for the default
+  uint32_t m_earlyDataLimit;            //!< client bytes staged per session while connecting
+  uint64_t m_forwarded;                 //!< bytes forwarded, both directions
+  uint32_t m_liveSessions;              //!< number of open sessions
+  uint64_t m_memory;                    //!< memory held by the open sessions
+  uint64_t m_peakMemory;                //!< largest m_memory seen
+
+  /// Connections opened in advance to one server
+  struct Pool
+  {
+    Pool () : connecting (0) {}
+    std::deque<Ptr<Socket> > idle; //!< established, not used yet
+    uint32_t connecting;           //!< being established
+  };
+  uint32_t m_poolSize;                  //!< connections kept ready per server
+  std::map<Address, Pool> m_pools;      //!< pools by server address
+  std::map<Ptr<Socket>, Address> m_pooled; //!< server of each pooled socket not in use
+  uint32_t m_poolHits;                  //!< clients given a pooled connection
+  uint32_t m_poolMisses;                //!< clients that waited for a new connection
+
+  bool m_backPressure;                  //!< cap receive windows by the drain rate
+  Time m_backPressureDelay;             //!< backlog allowed, in time at the drain rate
+  Histogram m_occupancy;                //!< backlog of all sessions, bytes
+  Histogram m_sojourn;                  //!< sojourn time in all sessions, seconds
+
+  uint32_t m_nextSessionId;             //!< number of the next session
+  std::string m_telemetryFile;          //!< CSV file of the session telemetry, empty for none
+  std::vector<ProxySessionStats> m_closedStats; //!< telemetry of the closed sessions, for the file
+  TracedCallback<const ProxySessionStats &> m_sessionClosedTrace; //!< telemetry of each closed session
 };
 
+ProxySession::ProxySession (TcpProxy *proxy, Ptr<Socket> iSocket, Ptr<Socket> oSocket,
+                            const Address &destination)
+  : m_proxy (proxy),
+    m_memory (0),
+    m_released (false),
+    m_connecting (true),
+    m_staged (Create<Packet> ()),
+    m_stageLimit (0),
+    m_occupancy (1024),
+    m_sojourn (0.001)
+{
+  m_legs[0] = iSocket;
+  m_legs[1] = oSocket;
+  for (int i = 0; i < 2; ++i)
+    {
+      m_sndBuf[i] = 0;
+      m_finished[i] = false;
+      m_shutdown[i] = false;
+      m_closed[i] = false;
+      m_pending[i] = false;
+      m_flows[i].lastSample = Simulator::Now ();
+    }
+  m_stats.id = proxy->m_nextSessionId++;
+  m_stats.destination = destination;
+  m_stats.start = Simulator::Now ();
+}
+
+void
+ProxySession::Start (bool connected)
+{
+  for (int i = 0; i < 2; ++i)
+    {
+      UintegerValue sndBuf;
+      m_legs[i]->GetAttribute ("SndBufSize", sndBuf);
+      m_sndBuf[i] = sndBuf.Get ();
+      UintegerValue segSize;
+      m_legs[i]->GetAttribute ("SegmentSize", segSize);
+      m_segSize[i] = segSize.Get ();
+      m_legs[i]->SetRecvCallback (MakeCallback (&ProxySession::HandleRecv, this));
+      m_legs[i]->SetSendCallback (MakeCallback (&ProxySession::HandleSend, this));
+    }
+  m_legs[0]->TraceConnectWithoutContext ("State", MakeCallback (&ProxySession::HandleIState, this));
+  m_legs[1]->TraceConnectWithoutContext ("State", MakeCallback (&ProxySession::HandleOState, this));
+  if (m_proxy->m_backPressure)
+    {
+      DynamicCast<TcpSocketBase> (m_legs[0])->SetWindowCapCallback (MakeCallback (&ProxySession::GetClientWindowCap, this));
+      DynamicCast<TcpSocketBase> (m_legs[1])->SetWindowCapCallback (MakeCallback (&ProxySession::GetServerWindowCap, this));
+    }
+  if (connected)
+    {
+      m_connecting = false;
+      m_flows[0].written += m_proxy->Forward (m_legs[0], m_legs[1]);
+    }
+  else
+    {
+      m_legs[1]->SetConnectCallback (MakeCallback (&ProxySession::HandleConnected, this),
+                                     MakeCallback (&ProxySession::HandleConnectFailed, this));
+      // The staged data must fit in the server leg's send buffer at once,
+      // after the chain header if any
+      m_stageLimit = std::min (m_proxy->m_earlyDataLimit, m_legs[1]->GetTxAvailable ());
+      Stage ();
+    }
+  Account ();
+}
+
+void
+ProxySession::Release (void)
+{
+  m_flushEvent.Cancel ();
+  for (int i = 0; i < 2; ++i)
+    {
+      m_legs[i]->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_legs[i]->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+    }
+  m_legs[1]->SetConnectCallback (MakeNullCallback<void, Ptr<Socket> > (),
+                                 MakeNullCallback<void, Ptr<Socket> > ());
+  m_legs[0]->TraceDisconnectWithoutContext ("State", MakeCallback (&ProxySession::HandleIState, this));
+  m_legs[1]->TraceDisconnectWithoutContext ("State", MakeCallback (&ProxySession::HandleOState, this));
+  for (int i = 0; i < 2; ++i)
+    {
+      DynamicCast<TcpSocketBase> (m_legs[i])->SetWindowCapCallback (MakeNullCallback<uint32_t> ());
+    }
+  NS_LOG_INFO ("Session " << this << " backlog histogram (bytes: count):" << HistogramString (m_occupancy));
+  NS_LOG_INFO ("Session " << this << " sojourn histogram (s: count):" << HistogramString (m_sojourn));
+  m_proxy->UpdateMemory (-static_cast<int64_t> (m_memory));
+  m_memory = 0;
+}
+
+Ptr<Socket>
+ProxySession::GetPeer (Ptr<Socket> socket) const
+{
+  return socket == m_legs[0] ? m_legs[1] : m_legs[0];
+}
+
+ProxySessionStats
+ProxySession::GetStats (void) const
+{
+  ProxySessionStats stats = m_stats;
+  stats.end = Simulator::Now ();
+  for (int i = 0; i < 2; ++i)
+    {
+      const Flow &f = m_flows[i];
+      stats.bytes[i] = f.written;
+      if (f.sendStalled)
+        {
+          stats.sendStall[i] += stats.end - f.lastSample;
+        }
+      if (f.recvStalled)
+        {
+          stats.recvStall[i] += stats.end - f.lastSample;
+        }
+    }
+  return stats;
+}
+
+void
+ProxySession::HandleRecv (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  if (m_connecting)
+    {
+      Stage ();
+      Account ();
+      return;
+    }
+  Pass (socket == m_legs[0] ? 0 : 1);
+}
+
+void
+ProxySession::HandleSend (Ptr<Socket> socket, uint32_t bytesSent)
+{
+  NS_LOG_FUNCTION (this << socket << bytesSent);
+  if (m_connecting)
+    {
+      return;
+    }
+  Pass (socket == m_legs[0] ? 1 : 0);
+}
+
+void
+ProxySession::Pass (int leg)
+{
+  if (m_proxy->m_coalesce)
+    { // Once per time step, after the other events of the sockets
+      m_pending[leg] = true;
+      if (!m_flushEvent.IsRunning ())
+        {
+          m_flushEvent = Simulator::ScheduleNow (&ProxySession::Flush, this);
+        }
+      return;
+    }
+  m_flows[leg].written += m_proxy->Forward (m_legs[leg], m_legs[1 - leg]);
+  Propagate (leg);
+  Account ();
+}
+
+void
+ProxySession::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (int leg = 0; leg < 2; ++leg)
+    {
+      if (m_pending[leg])
+        {
+          m_pending[leg] = false;
+          m_flows[leg].written += m_proxy->Forward (m_legs[leg], m_legs[1 - leg]);
+          Propagate (leg);
+        }
+    }
+  Account ();
+}
+
+void
+ProxySession::HandleConnected (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  m_connecting = false;
+  if (m_staged->GetSize () > 0)
+    {
+      NS_LOG_LOGIC ("Sending " << m_staged->GetSize () << " bytes of early data");
+      m_proxy->m_forwarded += m_staged->GetSize ();
+      m_flows[0].written += m_staged->GetSize ();
+      m_legs[1]->Send (m_staged);
+      m_staged = Create<Packet> ();
+    }
+  m_flows[0].written += m_proxy->Forward (m_legs[0], m_legs[1]);
+  Propagate (0);
+  Account ();
+}
+
+void
+ProxySession::HandleConnectFailed (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  m_connecting = false;
+  m_staged = Create<Packet> ();
+  // Leaving SYN_SENT for CLOSED resets the client leg, see HandleState
+  DynamicCast<TcpSocketBase> (m_legs[1])->Abort ();
+}
+
+void
+ProxySession::Stage (void)
+{
+  while (m_staged->GetSize () < m_stageLimit && m_legs[0]->GetRxAvailable () > 0)
+    {
+      m_staged->AddAtEnd (m_legs[0]->Recv (m_stageLimit - m_staged->GetSize (), 0));
+    }
+}
+
+void
+ProxySession::HandleIState (TcpStates_t oldState, TcpStates_t newState)
+{
+  HandleState (0, oldState, newState);
+}
+
+void
+ProxySession::HandleOState (TcpStates_t oldState, TcpStates_t newState)
+{
+  HandleState (1, oldState, newState);
+}
+
+void
+ProxySession::HandleState (int leg, TcpStates_t oldState, TcpStates_t newState)
+{
+  NS_LOG_FUNCTION (this << leg << TcpStateName[oldState] << TcpStateName[newState]);
+  if (newState == CLOSE_WAIT || newState == CLOSING || newState == TIME_WAIT)
+    { // The peer of this leg sent its FIN
+      m_finished[leg] = true;
+      Propagate (leg);
+    }
+  if (newState == CLOSED || newState == TIME_WAIT)
+    {
+      m_closed[leg] = true;
+      if (newState == CLOSED && oldState != LAST_ACK && oldState != TIME_WAIT
+          && !m_closed[1 - leg])
+        { // Reset, or the connection could not be established
+          NS_LOG_LOGIC ("Leg " << leg << " reset in " << TcpStateName[oldState] << ", aborting the other");
+          DynamicCast<TcpSocketBase> (m_legs[1 - leg])->Abort ();
+        }
+    }
+  if (!m_released && m_closed[0] && m_closed[1])
+    { // Not from within the socket's trace, which Release () disconnects
+      m_released = true;
+      Simulator::ScheduleNow (&TcpProxy::RemoveSession, m_proxy, Ptr<ProxySession> (this));
+    }
+}
+
+void
+ProxySession::Propagate (int leg)
+{
+  if (m_finished[leg] && !m_shutdown[1 - leg] && !m_closed[1 - leg] && !m_connecting
+      && m_legs[leg]->GetRxAvailable () == 0)
+    {
+      NS_LOG_LOGIC ("Leg " << leg << " finished, shutting down the other");
+      m_shutdown[1 - leg] = true;
+      m_legs[1 - leg]->ShutdownSend ();
+    }
+}
+
+void
+ProxySession::Account (void)
+{
+  uint64_t memory = sizeof (ProxySession) + 2 * sizeof (TcpSocketBase) + m_staged->GetSize ();
+  for (int i = 0; i < 2; ++i)
+    {
+      memory += m_legs[i]->GetRxAvailable () + m_sndBuf[i] - m_legs[i]->GetTxAvailable ();
+    }
+  m_proxy->UpdateMemory (static_cast<int64_t> (memory) - static_cast<int64_t> (m_memory));
+  m_memory = memory;
+  Measure (0);
+  Measure (1);
+}
+
+void
+ProxySession::Measure (int leg)
+{
+  Flow &f = m_flows[leg];
+  Time now = Simulator::Now ();
+  uint64_t received = f.written + m_legs[leg]->GetRxAvailable () + (leg == 0 ? m_staged->GetSize () : 0);
+  uint64_t drained = f.written - (m_sndBuf[1 - leg] - m_legs[1 - leg]->GetTxAvailable ());
+  // The legs were in the state of the last sample since then
+  if (f.sendStalled)
+    {
+      m_stats.sendStall[leg] += now - f.lastSample;
+    }
+  if (f.recvStalled)
+    {
+      m_stats.recvStall[leg] += now - f.lastSample;
+    }
+  f.lastSample = now;
+  uint32_t rxAvailable = m_legs[leg]->GetRxAvailable ();
+  f.sendStalled = !m_connecting && rxAvailable > 0 && m_legs[1 - leg]->GetTxAvailable () == 0;
+  f.recvStalled = !m_connecting && rxAvailable == 0 && !m_finished[leg] && !m_closed[leg];
+  m_stats.peakBuffered[leg] = std::max (m_stats.peakBuffered[leg], received - drained);
+  if (received > f.received)
+    {
+      f.arrivals.push_back (std::make_pair (received, now));
+      f.received = received;
+    }
+  while (!f.arrivals.empty () && f.arrivals.front ().first <= drained)
+    {
+      Time sojourn = now - f.arrivals.front ().second;
+      m_sojourn.AddValue (sojourn.GetSeconds ());
+      m_proxy->m_sojourn.AddValue (sojourn.GetSeconds ());
+      f.arrivals.pop_front ();
+    }
+  if (drained > f.drained && now > f.lastDrain)
+    { // Samples taken at the same time add up into the next one
+      if (f.lastDrain.IsStrictlyPositive ())
+        {
+          double sample = (drained - f.drained) / (now - f.lastDrain).GetSeconds ();
+          f.rate = f.rate > 0 ? 0.875 * f.rate + 0.125 * sample : sample;
+        }
+      f.lastDrain = now;
+      f.drained = drained;
+    }
+  m_occupancy.AddValue (received - drained);
+  m_proxy->m_occupancy.AddValue (received - drained);
+
+  if (m_proxy->m_backPressure && !m_connecting && !m_closed[leg]
+      && WindowCap (leg) >= static_cast<uint64_t> (f.advertised) + 2 * m_segSize[leg])
+    { // The cap opened since the last window announced: update it
+      DynamicCast<TcpSocketBase> (m_legs[leg])->SendEmptyPacket (TcpHeader::ACK);
+    }
+}
+
+uint32_t
+ProxySession::GetClientWindowCap (void)
+{
+  return m_flows[0].advertised = WindowCap (0);
+}
+
+uint32_t
+ProxySession::GetServerWindowCap (void)
+{
+  return m_flows[1].advertised = WindowCap (1);
+}
+
+uint32_t
+ProxySession::WindowCap (int leg)
+{
+  const Flow &f = m_flows[leg];
+  if (f.rate == 0)
+    { // Nothing drained yet, no bound
+      return 0xffffffff;
+    }
+  double target = f.rate * m_proxy->m_backPressureDelay.GetSeconds ();
+  double backlog = f.received - f.drained;
+  // Never close the window, the drain rate would not be measured again
+  return static_cast<uint32_t> (std::max (target - backlog, 2.0 * m_segSize[leg]));
+}
+
 TypeId
 TcpProxy::GetTypeId (void)
 {
@@ -78,11 +695,104 @@ TcpProxy::GetTypeId (void)
                    UintegerValue (0),
                    MakeUintegerAccessor (&TcpProxy::m_port),
                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("Splice", "Move data between sockets with SpliceTo instead of Recv and Send.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpProxy::m_splice),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Coalesce", "Forward once per time step and session, at the end of the step, "
+                   "instead of on every socket callback.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpProxy::m_coalesce),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ForwardCalls", "Number of forwarding passes.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::GetForwardCalls),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("SendCalls", "Number of Send () or SpliceTo () calls on the sockets.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::GetSendCalls),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("ClientSocketType", "TCP variant (TypeId name, e.g. ns3::TcpNewVegas) of the sockets "
+                   "accepted from the clients. Empty for ns3::TcpL4Protocol::SocketType.",
+                   StringValue (""),
+                   MakeStringAccessor (&TcpProxy::m_clientSocketType),
+                   MakeStringChecker ())
+    .AddAttribute ("ServerSocketType", "TCP variant (TypeId name, e.g. ns3::TcpCubic) of the sockets "
+                   "opened to the servers. Empty for ns3::TcpL4Protocol::SocketType.",
+                   StringValue (""),
+                   MakeStringAccessor (&TcpProxy::m_serverSocketType),
+                   MakeStringChecker ())
+    .AddAttribute ("EarlyDataLimit", "Bytes read from a client while the connection to its server "
+                   "is being established, sent as soon as it is. 0 leaves them in the client socket.",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&TcpProxy::m_earlyDataLimit),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PoolSize", "Connections to each server opened in advance and handed to the "
+                   "next clients, refilled in the background. 0 disables the pool.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::m_poolSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PoolHits", "Clients given a pooled connection.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::GetPoolHits),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PoolMisses", "Clients that found the pool empty.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::GetPoolMisses),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("BackPressure", "Cap the window of the receiving leg of each direction by the "
+                   "rate at which the sending leg drains the data.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpProxy::m_backPressure),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BackPressureDelay", "Backlog allowed per direction with back-pressure, "
+                   "as the time the sending leg takes to drain it.",
+                   TimeValue (MilliSeconds (20)),
+                   MakeTimeAccessor (&TcpProxy::m_backPressureDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("LiveSessions", "Number of proxied connections currently open.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::GetLiveSessions),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PeakMemory", "Largest memory, in bytes, held at once by the open sessions: "
+                   "session and socket objects, and the data in the socket buffers.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpProxy::GetPeakMemory),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("TelemetryFile", "File the telemetry of every session is written to, as CSV, "
+                   "when the proxy stops. Empty for none.",
+                   StringValue (""),
+                   MakeStringAccessor (&TcpProxy::m_telemetryFile),
+                   MakeStringChecker ())
+    .AddTraceSource ("SessionClosed", "Telemetry of a session, when it is closed.",
+                     MakeTraceSourceAccessor (&TcpProxy::m_sessionClosedTrace))
   ;
   return tid;
 }
 
 TcpProxy::TcpProxy ()
+  : m_splice (false),
+    m_coalesce (false),
+    m_forwardCalls (0),
+    m_sendCalls (0),
+    m_earlyDataLimit (65536),
+    m_forwarded (0),
+    m_liveSessions (0),
+    m_memory (0),
+    m_peakMemory (0),
+    m_poolSize (0),
+    m_poolHits (0),
+    m_poolMisses (0),
+    m_backPressure (false),
+    m_occupancy (1024),
+    m_sojourn (0.001),
+    m_nextSessionId (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -96,6 +806,13 @@ void
 TcpProxy::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  for (std::list<Ptr<ProxySession> >::iterator i = m_sessions.begin (); i != m_sessions.end (); ++i)
+    {
+      (*i)->Release ();
+    }
+  m_sessions.clear ();
+  m_liveSessions = 0;
+  ClosePool ();
   Application::DoDispose ();
 }
 
@@ -106,8 +823,8 @@ TcpProxy::StartApplication (void)
 
   if (m_socket == 0)
     {
-      TypeId tid = TypeId::LookupByName ("ns3::TcpSocketFactory");
-      m_socket = Socket::CreateSocket (GetNode (), tid);
+      // Accepted sockets are forked from the listener, they share its variant
+      m_socket = CreateTcpSocket (m_clientSocketType);
 	  
 	  m_socket->Bind (InetSocketAddress(m_port));
       
@@ -115,9 +832,22 @@ TcpProxy::StartApplication (void)
 								   MakeCallback (&TcpProxy::HandleConnectionCreated, this));
       m_socket->Listen ();
     }
-  
-  m_iSockets.reserve(8);
-  m_oSockets.reserve(8);
+
+  m_admission.Build ();
+
+  if (m_poolSize > 0)
+    { // One pool per next hop: a server (destination with a port) or the next proxy
+      for (uint32_t i = 0; i < m_admission.GetNRules (); ++i)
+        {
+          InetSocketAddress destination = InetSocketAddress::ConvertFrom (m_admission.GetValue (i));
+          if (destination.GetPort () != 0)
+            {
+              Address next = destination;
+              LookupRoute (destination.GetIpv4 (), next);
+              FillPool (next);
+            }
+        }
+    }
 }
 
 void 
@@ -132,6 +862,55 @@ TcpProxy::StopApplication ()
 								   MakeNullCallback<void, Ptr<Socket>, const Address &> ());
       m_socket = 0;
     }
+  ClosePool ();
+  FlushTelemetry ();
+}
+
+void
+TcpProxy::FlushTelemetry (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_telemetryFile.empty ())
+    { // Closed sessions, then a snapshot of the open ones
+      std::vector<ProxySessionStats> stats (m_closedStats);
+      for (std::list<Ptr<ProxySession> >::iterator i = m_sessions.begin (); i != m_sessions.end (); ++i)
+        {
+          stats.push_back ((*i)->GetStats ());
+        }
+      WriteTelemetry (stats);
+    }
+}
+
+void
+TcpProxy::WriteTelemetry (const std::vector<ProxySessionStats> &stats) const
+{
+  std::ofstream out (m_telemetryFile.c_str ());
+  if (!out)
+    {
+      NS_LOG_WARN ("Cannot open " << m_telemetryFile);
+      return;
+    }
+  out << "session,server,start,end";
+  static const char *directions[] = {"up", "down"};
+  for (int d = 0; d < 2; ++d)
+    {
+      out << "," << directions[d] << "_bytes," << directions[d] << "_send_stall,"
+          << directions[d] << "_recv_stall," << directions[d] << "_peak_buffered";
+    }
+  out << std::endl;
+  for (std::vector<ProxySessionStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      InetSocketAddress server = InetSocketAddress::ConvertFrom (i->destination);
+      out << i->id << "," << server.GetIpv4 () << ":" << server.GetPort () << ","
+          << i->start.GetSeconds () << "," << i->end.GetSeconds ();
+      for (int d = 0; d < 2; ++d)
+        {
+          out << "," << i->bytes[d] << "," << i->sendStall[d].GetSeconds ()
+              << "," << i->recvStall[d].GetSeconds () << "," << i->peakBuffered[d];
+        }
+      out << std::endl;
+    }
+  NS_LOG_INFO ("Telemetry of " << stats.size () << " sessions written to " << m_telemetryFile);
 }
 
 bool
@@ -139,99 +918,176 @@ TcpProxy::HandleRequest (Ptr<Socket> socket, const Address &address)
 {
   NS_LOG_FUNCTION (this << socket << address);
   
-  return m_pair.find (InetSocketAddress::ConvertFrom(address).GetIpv4 ()) != m_pair.end();
+  InetSocketAddress src = InetSocketAddress::ConvertFrom (address);
+  Address destination;
+  return m_upstreams.find (src.GetIpv4 ()) != m_upstreams.end ()
+    || m_admission.Lookup (src.GetIpv4 (), src.GetPort (), destination);
 }
 
 void
 TcpProxy::HandleConnectionCreated (Ptr<Socket> socket, const Address &address)
 {
   NS_LOG_FUNCTION (this << socket << address);
-  TypeId tid = TypeId::LookupByName ("ns3::TcpSocketFactory");
-  Ptr<Socket> oSocket = Socket::CreateSocket (GetNode (), tid);
-  Ipv4Address srcip = InetSocketAddress::ConvertFrom (address).GetIpv4 ();
-  InetSocketAddress disa = InetSocketAddress::ConvertFrom (m_pair[srcip]);
-  
-  if (oSocket->Connect (disa) == 0)
-	{
-	  // If connection is successful, add sockets to the map
-	  m_map[oSocket] = m_oSockets.size ();
-	  m_map[socket] = m_iSockets.size ();
-  
-	  // Remember both sockets to retrieve them later using the map
-	  m_oSockets.push_back (oSocket);
-	  m_iSockets.push_back (socket);
-	  
-	  // Set callbacks for package reception
-	  oSocket->SetRecvCallback (MakeCallback (&TcpProxy::HandleRecv, this));
-	  socket->SetRecvCallback (MakeCallback (&TcpProxy::HandleRecv, this));
-	  
-	  // Set callbacks for new available space to transmit
-	  oSocket->SetSendCallback (MakeCallback (&TcpProxy::HandleSend, this));
-	  socket->SetSendCallback (MakeCallback (&TcpProxy::HandleSend, this));
-	  
+  InetSocketAddress src = InetSocketAddress::ConvertFrom (address);
+
+  if (m_upstreams.find (src.GetIpv4 ()) != m_upstreams.end ())
+	{ // The previous proxy of the chain sends the destination first
+	  socket->SetRecvCallback (MakeCallback (&TcpProxy::HandleChainHeader, this));
+	  HandleChainHeader (socket);
 	  return;
 	}
-  else
+  Address destination;
+  m_admission.Lookup (src.GetIpv4 (), src.GetPort (), destination);
+  OpenSession (socket, InetSocketAddress::ConvertFrom (destination));
+}
+
+void
+TcpProxy::HandleChainHeader (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  if (socket->GetRxAvailable () < CHAIN_HEADER_SIZE)
 	{
-	  NS_LOG_WARN ("Connection failed");
+	  return;
 	}
+  uint8_t buf[CHAIN_HEADER_SIZE];
+  socket->Recv (CHAIN_HEADER_SIZE, 0)->CopyData (buf, CHAIN_HEADER_SIZE);
+  socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+  // The data following the header is read when the session starts
+  InetSocketAddress destination (Ipv4Address::Deserialize (buf), (buf[4] << 8) | buf[5]);
+  NS_LOG_INFO ("Chained connection to " << destination.GetIpv4 () << ":" << destination.GetPort ());
+  OpenSession (socket, destination);
 }
 
 void
-TcpProxy::HandleRecv (Ptr<Socket> socket)
+TcpProxy::SendChainHeader (Ptr<Socket> socket, InetSocketAddress destination)
 {
-  NS_LOG_FUNCTION (this << socket);
-  
-  Ptr<Socket> iSocket;
-  Ptr<Socket> oSocket;
-  
-  NS_ABORT_MSG_UNLESS (m_map.find (socket) != m_map.end (), "Unmapped socket");
-  
-  iSocket = m_iSockets[m_map[socket]];
-  oSocket = m_oSockets[m_map[socket]];
-  
-  if (oSocket == socket)
+  NS_LOG_FUNCTION (this << socket << destination.GetIpv4 () << destination.GetPort ());
+  uint8_t buf[CHAIN_HEADER_SIZE];
+  destination.GetIpv4 ().Serialize (buf);
+  buf[4] = destination.GetPort () >> 8;
+  buf[5] = destination.GetPort () & 0xff;
+  // Queued before any data of the client, even while connecting
+  socket->Send (Create<Packet> (buf, CHAIN_HEADER_SIZE));
+}
+
+bool
+TcpProxy::LookupRoute (Ipv4Address destination, Address &nextHop) const
+{
+  for (std::vector<Route>::const_iterator i = m_routes.begin (); i != m_routes.end (); ++i)
 	{
-	  oSocket = iSocket;
-	  iSocket = socket;
+	  if (i->mask.IsMatch (destination, i->network))
+		{
+		  nextHop = i->nextHop;
+		  return true;
+		}
 	}
-  
-  NS_LOG_LOGIC ("iSocket" << iSocket);
-  NS_LOG_LOGIC ("oSocket" << oSocket);
-  
-  Forward (iSocket, oSocket);
+  return false;
 }
 
 void
-TcpProxy::HandleSend (Ptr<Socket> socket, uint32_t bytesSent)
+TcpProxy::OpenSession (Ptr<Socket> socket, InetSocketAddress destination)
 {
-  NS_LOG_FUNCTION (this << socket << bytesSent);
-  
-  Ptr<Socket> iSocket;
-  Ptr<Socket> oSocket;
-  
-  NS_ABORT_MSG_UNLESS (m_map.find (socket) != m_map.end (), "Unmapped socket");
-  
-  iSocket = m_iSockets[m_map[socket]];
-  oSocket = m_oSockets[m_map[socket]];
-  
-  if (iSocket == socket)
+  NS_LOG_FUNCTION (this << socket << destination.GetIpv4 () << destination.GetPort ());
+  Address disa = destination;
+  bool chained = LookupRoute (destination.GetIpv4 (), disa);
+
+  if (m_poolSize > 0)
+	{
+	  Pool &pool = m_pools[disa];
+	  if (!pool.idle.empty ())
+		{ // Established already: no handshake on the server leg
+		  Ptr<Socket> oSocket = pool.idle.front ();
+		  pool.idle.pop_front ();
+		  m_pooled.erase (oSocket);
+		  oSocket->SetCloseCallbacks (MakeNullCallback<void, Ptr<Socket> > (),
+									  MakeNullCallback<void, Ptr<Socket> > ());
+		  m_poolHits++;
+		  Simulator::ScheduleNow (&TcpProxy::FillPool, this, disa);
+		  if (chained)
+			{
+			  SendChainHeader (oSocket, destination);
+			}
+		  Ptr<ProxySession> session = Create<ProxySession> (this, socket, oSocket, destination);
+		  session->m_self = m_sessions.insert (m_sessions.end (), session);
+		  m_liveSessions++;
+		  session->Start (true);
+		  return;
+		}
+	  m_poolMisses++;
+	  Simulator::ScheduleNow (&TcpProxy::FillPool, this, disa);
+	}
+
+  Ptr<Socket> oSocket = CreateTcpSocket (m_serverSocketType);
+  if (oSocket->Connect (disa) == 0)
+	{
+	  if (chained)
+		{
+		  SendChainHeader (oSocket, destination);
+		}
+	  // If connection is successful, the session takes over both sockets
+	  Ptr<ProxySession> session = Create<ProxySession> (this, socket, oSocket, destination);
+	  session->m_self = m_sessions.insert (m_sessions.end (), session);
+	  m_liveSessions++;
+	  session->Start (false);
+	  return;
+	}
+  else
 	{
-	  iSocket = oSocket;
-	  oSocket = socket;
+	  NS_LOG_WARN ("Connection failed");
 	}
-  
-  NS_LOG_LOGIC ("iSocket" << iSocket);
-  NS_LOG_LOGIC ("oSocket" << oSocket);
-  
-  Forward (iSocket, oSocket);
 }
 
 void
+TcpProxy::RemoveSession (Ptr<ProxySession> session)
+{
+  NS_LOG_FUNCTION (this << session);
+  ProxySessionStats stats = session->GetStats ();
+  m_sessionClosedTrace (stats);
+  if (!m_telemetryFile.empty ())
+    {
+      m_closedStats.push_back (stats);
+    }
+  session->Release ();
+  m_sessions.erase (session->m_self);
+  m_liveSessions--;
+  NS_LOG_INFO ("Session closed, " << m_liveSessions << " left");
+}
+
+void
+TcpProxy::UpdateMemory (int64_t delta)
+{
+  m_memory += delta;
+  m_peakMemory = std::max (m_peakMemory, m_memory);
+}
+
+uint32_t
 TcpProxy::Forward (Ptr<Socket> src, Ptr<Socket> dst)
 {
   NS_LOG_FUNCTION (this << src << dst);
+  uint32_t forwarded = 0;
+  m_forwardCalls++;
   
+  if (m_splice)
+	{
+	  Ptr<TcpSocketBase> tcpSrc = DynamicCast<TcpSocketBase> (src);
+	  Ptr<TcpSocketBase> tcpDst = DynamicCast<TcpSocketBase> (dst);
+	  NS_ABORT_MSG_UNLESS (tcpSrc != 0 && tcpDst != 0, "Splicing needs TCP sockets");
+	  // A single call moves what fits, the send callback resumes later
+	  int moved = tcpSrc->SpliceTo (tcpDst, tcpSrc->GetRxAvailable ());
+	  m_sendCalls++;
+	  if (moved < 0)
+		{
+		  NS_LOG_WARN ("Splicing failed, errno " << tcpDst->GetErrno ());
+		}
+	  else
+		{
+		  NS_LOG_INFO ("Data spliced (" << moved << " bytes)");
+		  m_forwarded += moved;
+		  forwarded = moved;
+		}
+	  return forwarded;
+	}
+
   Ptr<Packet> packet;
   while (true)
 	{
@@ -248,16 +1104,114 @@ TcpProxy::Forward (Ptr<Socket> src, Ptr<Socket> dst)
 	  packet = src->Recv (dst->GetTxAvailable (), 0u);
 	  uint32_t size = packet->GetSize ();
 	  uint32_t real = dst->Send (packet);
+	  m_sendCalls++;
 	  
 	  if (size == real)
 		{
 		  NS_LOG_INFO ("Packet forwarded (" << size << " bytes)");
+		  m_forwarded += real;
+		  forwarded += real;
 		}
 	  else
 		{
 		  NS_LOG_WARN ("Packet was not forwarded correctly (" << size << " bytes expected, sent " << real << ")");
 		}
 	}
+  return forwarded;
+}
+
+Ptr<Socket>
+TcpProxy::CreateTcpSocket (const std::string &type)
+{
+  if (type.empty ())
+    {
+      return Socket::CreateSocket (GetNode (), TypeId::LookupByName ("ns3::TcpSocketFactory"));
+    }
+  return GetNode ()->GetObject<TcpL4Protocol> ()->CreateSocket (TypeId::LookupByName (type));
+}
+
+void
+TcpProxy::FillPool (Address server)
+{
+  NS_LOG_FUNCTION (this << server);
+  if (m_socket == 0)
+    { // Stopped: a refill scheduled by the last clients
+      return;
+    }
+  Pool &pool = m_pools[server];
+  while (pool.idle.size () + pool.connecting < m_poolSize)
+    {
+      Ptr<Socket> socket = CreateTcpSocket (m_serverSocketType);
+      if (socket->Connect (server) != 0)
+        {
+          NS_LOG_WARN ("Pool connection to " << server << " failed");
+          return;
+        }
+      m_pooled[socket] = server;
+      pool.connecting++;
+      socket->SetConnectCallback (MakeCallback (&TcpProxy::HandlePoolConnected, this),
+                                  MakeCallback (&TcpProxy::HandlePoolConnectFailed, this));
+    }
+}
+
+void
+TcpProxy::HandlePoolConnected (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  Pool &pool = m_pools[m_pooled[socket]];
+  pool.connecting--;
+  pool.idle.push_back (socket);
+  socket->SetConnectCallback (MakeNullCallback<void, Ptr<Socket> > (),
+                              MakeNullCallback<void, Ptr<Socket> > ());
+  // A pooled connection the server closes or resets is dropped
+  socket->SetCloseCallbacks (MakeCallback (&TcpProxy::HandlePoolClose, this),
+                             MakeCallback (&TcpProxy::HandlePoolClose, this));
+}
+
+void
+TcpProxy::HandlePoolConnectFailed (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  // Not retried until the next client for this server
+  m_pools[m_pooled[socket]].connecting--;
+  m_pooled.erase (socket);
+  DynamicCast<TcpSocketBase> (socket)->Abort ();
+}
+
+void
+TcpProxy::HandlePoolClose (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  std::map<Ptr<Socket>, Address>::iterator pooled = m_pooled.find (socket);
+  if (pooled == m_pooled.end ())
+    { // Already taken by a session or dropped
+      return;
+    }
+  std::deque<Ptr<Socket> > &idle = m_pools[pooled->second].idle;
+  std::deque<Ptr<Socket> >::iterator i = std::find (idle.begin (), idle.end (), socket);
+  if (i != idle.end ())
+    {
+      idle.erase (i);
+    }
+  m_pooled.erase (pooled);
+  socket->Close ();
+}
+
+void
+TcpProxy::ClosePool (void)
+{
+  NS_LOG_FUNCTION (this);
+  // Idle connections and those still connecting, none of them in a session
+  for (std::map<Ptr<Socket>, Address>::iterator i = m_pooled.begin (); i != m_pooled.end (); ++i)
+    {
+      i->first->SetConnectCallback (MakeNullCallback<void, Ptr<Socket> > (),
+                                    MakeNullCallback<void, Ptr<Socket> > ());
+      i->first->SetCloseCallbacks (MakeNullCallback<void, Ptr<Socket> > (),
+                                   MakeNullCallback<void, Ptr<Socket> > ());
+      i->first->Close ();
+    }
+  m_pooled.clear ();
+  m_pools.clear ();
 }
 
 void
@@ -266,8 +1220,42 @@ TcpProxy::AddPair (const Address srcip, uint16_t srcport, const Address dstip, u
   NS_LOG_FUNCTION (this << srcip << srcport << dstip << dstport);
   InetSocketAddress sisa = InetSocketAddress (Ipv4Address::ConvertFrom(dstip), dstport);
   InetSocketAddress disa = InetSocketAddress (Ipv4Address::ConvertFrom(srcip), srcport);
-  m_pair[srcip] = Address(sisa);
-  m_pair[dstip] = Address(disa);
+  // The source port is only known when given, and servers connect from any
+  Ipv4Mask host ("255.255.255.255");
+  AddRule (Ipv4Address::ConvertFrom(srcip), host, srcport, srcport ? srcport : 65535, Address(sisa));
+  AddRule (Ipv4Address::ConvertFrom(dstip), host, 0, 65535, Address(disa));
+}
+
+void
+TcpProxy::AddRule (Ipv4Address network, Ipv4Mask mask, uint16_t portLow, uint16_t portHigh,
+                   const Address destination)
+{
+  NS_LOG_FUNCTION (this << network << mask << portLow << portHigh << destination);
+  m_admission.Add (network, mask, portLow, portHigh, destination);
+}
+
+void
+TcpProxy::AddRoute (Ipv4Address network, Ipv4Mask mask, const Address nextHop)
+{
+  NS_LOG_FUNCTION (this << network << mask << nextHop);
+  Route route;
+  route.network = network.CombineMask (mask);
+  route.mask = mask;
+  route.nextHop = nextHop;
+  // The first match is the longest prefix
+  std::vector<Route>::iterator i = m_routes.begin ();
+  while (i != m_routes.end () && i->mask.GetPrefixLength () >= mask.GetPrefixLength ())
+    {
+      ++i;
+    }
+  m_routes.insert (i, route);
+}
+
+void
+TcpProxy::AddUpstream (const Address ip)
+{
+  NS_LOG_FUNCTION (this << ip);
+  m_upstreams.insert (ip);
 }
 
 void
@@ -277,6 +1265,60 @@ TcpProxy::SetPort (uint16_t port)
   m_port = port;
 }
 
+uint64_t
+TcpProxy::GetForwardedBytes (void) const
+{
+  return m_forwarded;
+}
+
+uint64_t
+TcpProxy::GetForwardCalls (void) const
+{
+  return m_forwardCalls;
+}
+
+uint64_t
+TcpProxy::GetSendCalls (void) const
+{
+  return m_sendCalls;
+}
+
+uint32_t
+TcpProxy::GetLiveSessions (void) const
+{
+  return m_liveSessions;
+}
+
+uint64_t
+TcpProxy::GetPeakMemory (void) const
+{
+  return m_peakMemory;
+}
+
+uint32_t
+TcpProxy::GetPoolHits (void) const
+{
+  return m_poolHits;
+}
+
+uint32_t
+TcpProxy::GetPoolMisses (void) const
+{
+  return m_poolMisses;
+}
+
+Histogram &
+TcpProxy::GetOccupancyHistogram (void)
+{
+  return m_occupancy;
+}
+
+Histogram &
+TcpProxy::GetSojournHistogram (void)
+{
+  return m_sojourn;
+}
+
 /* * * * * * * * * * * * * END OF TcpProxy CLASS * * * * * * * * * * * * */
 
 uint32_t cWnd0, cWnd1, cWnd2;
@@ -317,19 +1359,92 @@ CwndCng4 (uint32_t oldCwnd, uint32_t newCwnd)
   ;
 }
 
+static void
+SlowStartExit (uint32_t flow, uint32_t reason, uint32_t cwnd)
+{
+  static const char *reasons[] = {"ssthresh", "loss", "ack-train", "delay"};
+  printf ("# %.3f flow %u left slow start (%s) at cwnd %u\n",
+          Simulator::Now ().GetSeconds (), flow, reasons[reason], cwnd);
+}
+
+static void
+RttSample (uint32_t flow, Time rtt)
+{
+  printf ("# %.6f flow %d rtt %ld ns\n", Simulator::Now ().GetSeconds (), flow, (long) rtt.GetNanoSeconds ());
+}
+
+static void
+RateSample (uint32_t flow, DataRate rate, bool appLimited)
+{
+  printf ("# %.6f flow %d delivery rate %lu bps%s\n", Simulator::Now ().GetSeconds (), flow,
+          (unsigned long) rate.GetBitRate (), appLimited ? " (app limited)" : "");
+}
+
 typedef void (*FunPtr) (uint32_t ol, uint32_t nw);
 FunPtr CwndChange[] = {CwndCng0, CwndCng1, CwndCng2, CwndCng3, CwndCng4};
 
+/* Settings of one run of the experiment */
+struct ExperimentParams
+{
+  float start;
+  float stop;
+  float dt;
+  uint32_t data;
+  bool proxy;
+  bool splice;
+  double loss;
+  bool rttSamples;
+  bool rateSamples;
+  std::string delay;
+  uint32_t nSubnets;
+  uint32_t szSubnet;
+  uint16_t sPort;
+  uint16_t proxyPort;
+  std::string clientSocketType; //!< TCP variant of the proxy's client legs
+  std::string serverSocketType; //!< TCP variant of the proxy's server legs
+  uint32_t poolSize;            //!< Connections the proxy opens in advance per server
+  bool backPressure;            //!< Proxy caps windows by the drain rate
+  bool coalesce;                //!< Proxy forwards once per time step and session
+  uint32_t hops;                //!< Links between the client and server routers
+  std::vector<uint32_t> proxyAt; //!< Positions of the proxies on the path, in order
+  std::string telemetry;        //!< CSV file of the proxy session telemetry, empty for none
+};
+
+static void RunExperiment (const ExperimentParams &params);
+
 int
 main (int argc, char *argv[])
 {
   float start = 0.0;
   float stop = -1.0;
   float dt = 1.0;
-  uint32_t data = 1073741824;
+  const uint32_t defaultData = 1073741824;
+  uint32_t data = defaultData;
   bool proxy = false;
+  bool splice = false;
+  bool cubicFixedPoint = false;
+  bool hystart = false;
+  bool sack = false;
+  bool pacing = false;
+  bool prr = false;
+  double loss = 0.0;
+  uint32_t window = 0;
+  bool timestamps = true;
+  bool rttSamples = false;
+  bool rateSamples = false;
+  bool sweep = false;
+  bool lossSweep = false;
+  bool poolSweep = false;
   char delay[] = "60ms";
   char protocol[] = "NewReno";
+  std::string clientProtocol = "";
+  std::string serverProtocol = "";
+  uint32_t pool = 0;
+  bool backPressure = false;
+  bool coalesce = false;
+  uint32_t hops = 2;
+  std::string proxyAt = "1";
+  std::string telemetry = "";
   
   uint32_t nSubnets = 1;
   uint32_t szSubnet = 3;
@@ -341,9 +1456,32 @@ main (int argc, char *argv[])
   cmd.AddValue("nSubnets", "Number of client subnets", nSubnets);
   cmd.AddValue("szSubnet", "Number of clients per subnet", szSubnet);
   cmd.AddValue("data", "Max data to send for each client", data);
-  cmd.AddValue("delay", "Delay on (two) central links, RTT will be 4*delay", delay);
-  cmd.AddValue("protocol", "Congestion control protocol to use", protocol);
+  cmd.AddValue("delay", "Delay on each central link, RTT will be 2*hops*delay", delay);
+  cmd.AddValue("hops", "Number of central links between the client and server routers", hops);
+  cmd.AddValue("protocol", "Congestion control protocol to use (NewReno, Cubic, NewVegas, Bbr)", protocol);
   cmd.AddValue("proxy", "Enable proxy", proxy);
+  cmd.AddValue("proxyAt", "Comma-separated positions of the chained proxies on the path, "
+			   "from 0 (client router) to hops (server router)", proxyAt);
+  cmd.AddValue("splice", "Proxy forwards with SpliceTo instead of Recv and Send", splice);
+  cmd.AddValue("cubicFixedPoint", "Use the fixed-point CUBIC update", cubicFixedPoint);
+  cmd.AddValue("hystart", "Use HyStart to leave slow start (Cubic)", hystart);
+  cmd.AddValue("sack", "Enable selective acknowledgements", sack);
+  cmd.AddValue("pacing", "Pace the segments sent at cwnd/srtt times the controller's gain", pacing);
+  cmd.AddValue("prr", "Proportional rate reduction in fast recovery (Cubic, NewVegas) instead of cwnd inflation", prr);
+  cmd.AddValue("loss", "Random packet loss rate on the central link, e.g. 0.01", loss);
+  cmd.AddValue("window", "Socket buffers and max advertised window, in bytes (0: defaults)", window);
+  cmd.AddValue("timestamps", "Enable the timestamps option", timestamps);
+  cmd.AddValue("rttSamples", "Print the RTT measured on every ACK (needs timestamps)", rttSamples);
+  cmd.AddValue("rateSamples", "Print the delivery rate sampled on every new ACK", rateSamples);
+  cmd.AddValue("clientProtocol", "Congestion control of the proxy's client legs (default: protocol)", clientProtocol);
+  cmd.AddValue("serverProtocol", "Congestion control of the proxy's server legs (default: protocol)", serverProtocol);
+  cmd.AddValue("pool", "Connections the proxy opens in advance to each server", pool);
+  cmd.AddValue("backPressure", "Proxy caps receive windows by the drain rate of the other leg", backPressure);
+  cmd.AddValue("coalesce", "Proxy forwards once per time step and session", coalesce);
+  cmd.AddValue("telemetry", "CSV file of the proxy session telemetry, suffixed by position with several proxies", telemetry);
+  cmd.AddValue("sweep", "Run once per combination of client and server leg protocols (enables proxy)", sweep);
+  cmd.AddValue("lossSweep", "Run at 1% and 5% loss, without and with SACK (30 s unless --duration)", lossSweep);
+  cmd.AddValue("poolSweep", "Run the proxy without and with a pool of one connection per server (20 KB flows unless --data)", poolSweep);
   cmd.Parse (argc, argv);
   
   if (nSubnets < 1 || szSubnet < 1)
@@ -351,15 +1489,147 @@ main (int argc, char *argv[])
 	  std::cout << "Number of clients must be more than zero." << std::endl;
 	  exit (1);
 	}
+  if (hops < 2)
+	{
+	  std::cout << "The path needs at least two central links." << std::endl;
+	  exit (1);
+	}
+
+  std::vector<uint32_t> positions;
+  std::istringstream positionList (proxyAt);
+  std::string position;
+  while (std::getline (positionList, position, ','))
+	{
+	  positions.push_back (atoi (position.c_str ()));
+	}
+  std::sort (positions.begin (), positions.end ());
+  positions.erase (std::unique (positions.begin (), positions.end ()), positions.end ());
+  if (positions.empty () || positions.back () > hops)
+	{
+	  std::cout << "Proxy positions must be between 0 and " << hops << "." << std::endl;
+	  exit (1);
+	}
 
   std::stringstream pTypeId;
   pTypeId << "ns3::Tcp" << protocol;
 
   Config::SetDefault ("ns3::TcpL4Protocol::SocketType",
 					  TypeIdValue (TypeId::LookupByName (pTypeId.str ())));
+  Config::SetDefault ("ns3::TcpCubic::FixedPoint", BooleanValue (cubicFixedPoint));
+  Config::SetDefault ("ns3::TcpCubic::HyStart", BooleanValue (hystart));
+  Config::SetDefault ("ns3::TcpSocketBase::Sack", BooleanValue (sack));
+  Config::SetDefault ("ns3::TcpSocketBase::Pacing", BooleanValue (pacing));
+  Config::SetDefault ("ns3::TcpSocketBase::Prr", BooleanValue (prr));
+  Config::SetDefault ("ns3::TcpSocketBase::Timestamp", BooleanValue (timestamps));
+  if (window > 0)
+	{ // Above 64 KB, relies on window scaling
+	  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (window));
+	  Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue (window));
+	  Config::SetDefault ("ns3::TcpSocketBase::MaxWindowSize", UintegerValue (window));
+	}
   
   Time::SetResolution (Time::NS);
 
+  ExperimentParams params;
+  params.start = start;
+  params.stop = stop;
+  params.dt = dt;
+  params.data = data;
+  params.proxy = proxy || sweep;
+  params.splice = splice;
+  params.loss = loss;
+  params.rttSamples = rttSamples;
+  params.rateSamples = rateSamples;
+  params.delay = delay;
+  params.nSubnets = nSubnets;
+  params.szSubnet = szSubnet;
+  params.sPort = sPort;
+  params.proxyPort = proxyPort;
+  params.clientSocketType = clientProtocol.empty () ? "" : "ns3::Tcp" + clientProtocol;
+  params.serverSocketType = serverProtocol.empty () ? "" : "ns3::Tcp" + serverProtocol;
+  params.poolSize = pool;
+  params.backPressure = backPressure;
+  params.coalesce = coalesce;
+  params.hops = hops;
+  params.proxyAt = positions;
+  params.telemetry = telemetry;
+
+  if (lossSweep)
+	{ // Goodput of the loss recovery, by loss rate
+	  static const double rates[] = {0.01, 0.05};
+	  if (params.stop <= 0)
+		{
+		  params.stop = 30.0;
+		}
+	  for (uint32_t r = 0; r < sizeof (rates) / sizeof (rates[0]); ++r)
+		{
+		  for (uint32_t s = 0; s < 2; ++s)
+			{
+			  Config::SetDefault ("ns3::TcpSocketBase::Sack", BooleanValue (s == 1));
+			  params.loss = rates[r];
+			  std::cout << "# Loss " << rates[r] * 100 << "%, SACK "
+						<< (s == 1 ? "on" : "off") << std::endl;
+			  RunExperiment (params);
+			}
+		}
+	  return 0;
+	}
+  if (poolSweep)
+	{ // Flow completion time of the proxied flows, by pool size
+	  params.proxy = true;
+	  if (data == defaultData)
+		{
+		  params.data = 20000;
+		}
+	  for (uint32_t p = 0; p < 2; ++p)
+		{
+		  params.poolSize = p;
+		  std::cout << "# Pool size " << p << std::endl;
+		  RunExperiment (params);
+		}
+	  return 0;
+	}
+  if (!sweep)
+	{
+	  RunExperiment (params);
+	  return 0;
+	}
+
+  // Split-TCP tuning: every pair of variants on the two legs of the proxy
+  static const char *protocols[] = {"NewReno", "Cubic", "NewVegas", "Bbr"};
+  for (uint32_t c = 0; c < sizeof (protocols) / sizeof (protocols[0]); ++c)
+	{
+	  for (uint32_t s = 0; s < sizeof (protocols) / sizeof (protocols[0]); ++s)
+		{
+		  params.clientSocketType = std::string ("ns3::Tcp") + protocols[c];
+		  params.serverSocketType = std::string ("ns3::Tcp") + protocols[s];
+		  std::cout << "# Proxy legs: client " << protocols[c]
+					<< ", server " << protocols[s] << std::endl;
+		  RunExperiment (params);
+		}
+	}
+  return 0;
+}
+
+static void
+RunExperiment (const ExperimentParams &params)
+{
+  float start = params.start;
+  float stop = params.stop;
+  float dt = params.dt;
+  uint32_t data = params.data;
+  bool proxy = params.proxy;
+  bool splice = params.splice;
+  double loss = params.loss;
+  bool rttSamples = params.rttSamples;
+  bool rateSamples = params.rateSamples;
+  std::string delay = params.delay;
+  uint32_t nSubnets = params.nSubnets;
+  uint32_t szSubnet = params.szSubnet;
+  uint16_t sPort = params.sPort;
+  uint16_t proxyPort = params.proxyPort;
+  uint32_t hops = params.hops;
+
   NS_LOG_INFO ("Creating topology...");
   NS_LOG_LOGIC ("Creating nodes...");
 
@@ -378,14 +1648,17 @@ main (int argc, char *argv[])
 	  servers.Create (szSubnet);
 	}
   // Create middle and server routers
-  routers.Create (2);
+  routers.Create (hops);
   
-  NS_LOG_LOGIC ("Done creating " << (nSubnets * (2 * szSubnet + 1) + 2)
+  NS_LOG_LOGIC ("Done creating " << (nSubnets * (2 * szSubnet + 1) + hops)
 		  << " nodes.");
   
   NS_LOG_LOGIC ("Creating channels...");
   
-  std::vector<NetDeviceContainer> deviceContainers (nSubnets * (2 * szSubnet + 1) + 1);
+  std::vector<NetDeviceContainer> deviceContainers (nSubnets * (2 * szSubnet + 1) + hops - 1);
+  // Index of the first link between middle routers, and of the first server link
+  uint32_t core = (szSubnet + 1) * nSubnets;
+  uint32_t slinks = core + hops - 1;
   
   PointToPointHelper clinker;
   // Set attributes
@@ -424,17 +1697,26 @@ main (int argc, char *argv[])
 	  //linker.EnablePcap ("tcpexp", deviceContainers[nSubnets + i].Get (0), true);
 	}
   
-  // Connect middle router to server router
-  NodeContainer nodes;
-  nodes.Add (routers.Get(nSubnets));
-  nodes.Add (routers.Get(nSubnets+1));
-  
+  // Connect middle routers in a line, up to the server router
   PointToPointHelper linker;
   // Set attributes
   linker.SetDeviceAttribute("DataRate", StringValue("100Mbps"));
   linker.SetChannelAttribute("Delay", StringValue(delay));
 
-  deviceContainers[(szSubnet + 1) * nSubnets] = linker.Install (nodes);
+  for (uint32_t k = 0; k < hops - 1; ++k)
+	{
+	  NodeContainer nodes;
+	  nodes.Add (routers.Get(nSubnets + k));
+	  nodes.Add (routers.Get(nSubnets + k + 1));
+	  deviceContainers[core + k] = linker.Install (nodes);
+	}
+  if (loss > 0)
+	{ // Drop data packets at random on their way to the servers
+	  Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+	  em->SetAttribute ("ErrorRate", DoubleValue (loss));
+	  em->SetAttribute ("ErrorUnit", EnumValue (RateErrorModel::ERROR_UNIT_PACKET));
+	  deviceContainers[slinks - 1].Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+	}
   //linker.EnablePcap ("tcpexp", deviceContainers[2 * nSubnets].Get (0), true);
   
   // Finally, connect server subnet
@@ -448,8 +1730,8 @@ main (int argc, char *argv[])
 	{
 	  NodeContainer snodes;
 	  snodes.Add (servers.Get(i));
-	  snodes.Add (routers.Get(nSubnets+1));
-	  deviceContainers[(szSubnet + 1) * nSubnets + 1 + i] = slinker.Install (snodes);
+	  snodes.Add (routers.Get(nSubnets + hops - 1));
+	  deviceContainers[slinks + i] = slinker.Install (snodes);
 	  //slinker.EnablePcap ("tcpexp", deviceContainers[2 * nSubnets + 1].Get (0), true);
 	}
 
@@ -474,6 +1756,7 @@ main (int argc, char *argv[])
   // Iface containers to recall assigned IPs later during app installation
   std::vector<Ipv4InterfaceContainer> cIpIfaces(nSubnets * szSubnet);
   std::vector<Ipv4InterfaceContainer> pIpIfaces(nSubnets);
+  std::vector<Ipv4InterfaceContainer> mIpIfaces(hops - 1);
   std::vector<Ipv4InterfaceContainer> sIpIfaces(nSubnets * szSubnet);
   
   for (uint32_t i=0; i < nSubnets * szSubnet; i++)
@@ -492,15 +1775,20 @@ main (int argc, char *argv[])
 	  pIpIfaces[i] = addressHlpr.Assign(deviceContainers[nSubnets * szSubnet + i]);
 	}
   
-  addressHlpr.SetBase("10.2.0.0", "255.255.255.0");
-  addressHlpr.Assign(deviceContainers[nSubnets * (szSubnet + 1)]);
+  for (uint32_t k=0; k < hops - 1; k++)
+	{
+	  std::ostringstream sNetIp;
+	  sNetIp << "10.2." << k << ".0";
+	  addressHlpr.SetBase(sNetIp.str().c_str(), "255.255.255.0");
+	  mIpIfaces[k] = addressHlpr.Assign(deviceContainers[core + k]);
+	}
   
   for (uint32_t i=0; i < nSubnets * szSubnet; i++)
 	{
 	  std::ostringstream sNetIp;
 	  sNetIp << "10.3." << i << ".0";
 	  addressHlpr.SetBase(sNetIp.str().c_str(), "255.255.255.0");
-	  sIpIfaces[i] = addressHlpr.Assign(deviceContainers[(szSubnet + 1) * nSubnets + 1 + i]);
+	  sIpIfaces[i] = addressHlpr.Assign(deviceContainers[slinks + i]);
 	}
 
   NS_LOG_LOGIC ("Done setting addresses.");
@@ -514,16 +1802,84 @@ main (int argc, char *argv[])
   std::vector<Ptr<TcpSendApplication> > senders (nSubnets * szSubnet);
   std::vector<Ptr<PacketSink> > sinks (nSubnets * szSubnet);
   
-  Ptr<TcpProxy> proxyapp = CreateObject<TcpProxy> ();
-  
-  proxyapp->SetPort (proxyPort);
-  proxyapp->SetStartTime (Seconds (start));
-  if (stop > 0)
+  // Proxies of the chain of each subnet, by position on the path. The
+  // router of a subnet (position 0) has its own, the others are shared.
+  std::vector<std::vector<Ptr<TcpProxy> > > chain (params.proxyAt.size (),
+												   std::vector<Ptr<TcpProxy> > (nSubnets));
+  std::vector<Ptr<TcpProxy> > proxyapps;
+  std::vector<uint32_t> proxyPositions;
+  for (uint32_t k = 0; proxy && k < params.proxyAt.size (); ++k)
+	{
+	  uint32_t p = params.proxyAt[k];
+	  for (uint32_t i = 0; i < nSubnets; ++i)
+		{
+		  if (p > 0 && i > 0)
+			{
+			  chain[k][i] = chain[k][0];
+			  continue;
+			}
+		  Ptr<TcpProxy> proxyapp = CreateObject<TcpProxy> ();
+		  
+		  proxyapp->SetPort (proxyPort);
+		  proxyapp->SetAttribute ("Splice", BooleanValue (splice));
+		  proxyapp->SetAttribute ("ClientSocketType", StringValue (params.clientSocketType));
+		  proxyapp->SetAttribute ("ServerSocketType", StringValue (params.serverSocketType));
+		  proxyapp->SetAttribute ("PoolSize", UintegerValue (params.poolSize));
+		  proxyapp->SetAttribute ("BackPressure", BooleanValue (params.backPressure));
+		  proxyapp->SetAttribute ("Coalesce", BooleanValue (params.coalesce));
+		  if (!params.telemetry.empty ())
+			{
+			  std::ostringstream file;
+			  file << params.telemetry;
+			  if (params.proxyAt.size () > 1 || p == 0)
+				{ // One file per proxy: by position, and subnet on the client routers
+				  file << "." << p;
+				  if (p == 0)
+					{
+					  file << "." << i;
+					}
+				}
+			  proxyapp->SetAttribute ("TelemetryFile", StringValue (file.str ()));
+			}
+		  proxyapp->SetStartTime (Seconds (start));
+		  if (stop > 0)
+			{
+			  proxyapp->SetStopTime (Seconds (stop + dt * nSubnets * nSubnets * szSubnet * szSubnet));
+			}
+		  
+		  routers.Get (p == 0 ? i : nSubnets + p - 1)->AddApplication (proxyapp);
+		  chain[k][i] = proxyapp;
+		  proxyapps.push_back (proxyapp);
+		  proxyPositions.push_back (p);
+		}
+	}
+
+  // Addresses of the proxies on their side towards the clients of a subnet
+  std::vector<std::vector<Ipv4Address> > chainAddr (params.proxyAt.size (),
+													std::vector<Ipv4Address> (nSubnets));
+  for (uint32_t k = 0; k < params.proxyAt.size (); ++k)
 	{
-	  proxyapp->SetStopTime (Seconds (stop + dt * nSubnets * nSubnets * szSubnet * szSubnet));
+	  uint32_t p = params.proxyAt[k];
+	  for (uint32_t i = 0; i < nSubnets; ++i)
+		{
+		  chainAddr[k][i] = p == 0 ? cIpIfaces[i * szSubnet].GetAddress (0)
+			: p == 1 ? pIpIfaces[i].GetAddress (1) : mIpIfaces[p - 2].GetAddress (1);
+		}
+	}
+
+  // Each proxy sends the connections to the servers on to the next one,
+  // which accepts them from the address of the link it comes from
+  for (uint32_t k = 0; proxy && k + 1 < params.proxyAt.size (); ++k)
+	{
+	  uint32_t p = params.proxyAt[k];
+	  for (uint32_t i = 0; i < nSubnets && (p == 0 || i == 0); ++i)
+		{
+		  chain[k][i]->AddRoute (Ipv4Address ("10.3.0.0"), Ipv4Mask ("255.255.0.0"),
+								 InetSocketAddress (chainAddr[k + 1][i], proxyPort));
+		  chain[k + 1][i]->AddUpstream (p == 0 ? pIpIfaces[i].GetAddress (0)
+										: mIpIfaces[p - 1].GetAddress (0));
+		}
 	}
-  
-  routers.Get (nSubnets)->AddApplication (proxyapp);
   
   for (uint32_t i=0; i < nSubnets; ++i)
 	{
@@ -536,8 +1892,8 @@ main (int argc, char *argv[])
 		  
 		  if (proxy && j == 2u)
 			{
-			  paddr = pIpIfaces[i].GetAddress (1);
-			  proxyapp->AddPair (caddr, 0, saddr, sPort);
+			  paddr = chainAddr[0][i];
+			  chain[0][i]->AddPair (caddr, 0, saddr, sPort);
 			  pPort = proxyPort;
 			}
 		  
@@ -552,6 +1908,15 @@ main (int argc, char *argv[])
 		  
 		  Ptr<Socket> skt = DynamicCast<TcpSendApplication> (sender.Get (0))->GetSocket ();
 		  skt->TraceConnectWithoutContext ("CongestionWindow", MakeCallback (CwndChange[i * szSubnet + j]));
+		  skt->TraceConnectWithoutContext ("SlowStartExit", MakeBoundCallback (&SlowStartExit, i * szSubnet + j));
+		  if (rttSamples)
+			{
+			  skt->TraceConnectWithoutContext ("RttSample", MakeBoundCallback (&RttSample, i * szSubnet + j));
+			}
+		  if (rateSamples)
+			{
+			  skt->TraceConnectWithoutContext ("DeliveryRate", MakeBoundCallback (&RateSample, i * szSubnet + j));
+			}
 		  
 		  PacketSinkHelper psh("ns3::TcpSocketFactory",
 								InetSocketAddress(saddr, sPort));
@@ -570,10 +1935,47 @@ main (int argc, char *argv[])
 	  Simulator::Stop (Seconds (stop + dt * x * x));
 	}
   NS_LOG_INFO ("Starting simulation...");
+  // Wall clock time of the run, to compare the proxy forwarding paths
+  SystemWallClockMs wallClock;
+  wallClock.Start ();
   Simulator::Run ();
+  int64_t elapsed = wallClock.End ();
+  // Read the proxy counters before the simulator destroys the nodes
+  std::ostringstream report;
+  for (uint32_t n = 0; n < proxyapps.size (); ++n)
+	{
+	  Ptr<TcpProxy> proxyapp = proxyapps[n];
+	  // The proxies stop with the simulation at the earliest, not always before it
+	  proxyapp->FlushTelemetry ();
+	  uint64_t forwarded = proxyapp->GetForwardedBytes ();
+	  if (proxyapps.size () > 1)
+		{
+		  report << "# Proxy on the router at position " << proxyPositions[n] << " of the path:" << std::endl;
+		}
+	  report << "# Proxy forwarded " << forwarded << " bytes ("
+			 << (splice ? "SpliceTo" : "Recv/Send") << "), "
+			 << (elapsed > 0 ? forwarded / 1024.0 / elapsed : 0.0) << " MB/s of wall clock time." << std::endl;
+	  report << "# Proxy forwarding passes: " << proxyapp->GetForwardCalls ()
+			 << ", sends: " << proxyapp->GetSendCalls ()
+			 << (params.coalesce ? " (coalesced)" : "") << std::endl;
+	  report << "# Proxy sessions still open: " << proxyapp->GetLiveSessions ()
+			 << ", peak memory: " << proxyapp->GetPeakMemory () << " bytes." << std::endl;
+	  if (params.poolSize > 0)
+		{
+		  report << "# Proxy pool hits: " << proxyapp->GetPoolHits ()
+				 << ", misses: " << proxyapp->GetPoolMisses () << std::endl;
+		}
+	  report << "# Proxy backlog histogram (bytes: count):"
+			 << HistogramString (proxyapp->GetOccupancyHistogram ()) << std::endl;
+	  report << "# Proxy sojourn histogram (s: count):"
+			 << HistogramString (proxyapp->GetSojournHistogram ()) << std::endl;
+	}
   Simulator::Destroy ();
   NS_LOG_INFO ("Simulation completed.");
+  std::cout << "# Wall clock time: " << elapsed << " ms." << std::endl;
+  std::cout << report.str ();
   x = 0;
+  double goodput = 0.0;
   for (uint32_t i = 0; i < nSubnets; ++i)
 	{
 	  for (uint32_t j = 0; j < szSubnet; ++j, ++x)
@@ -591,7 +1993,8 @@ main (int argc, char *argv[])
 		  std::cout << "# Throughput on connection "
 						  << (szSubnet * i + j) << ": " << rx/time/128.0 << " Kbps." << std::endl;
 		  std::cout << "#" << std::endl;
+		  goodput += rx/time/128.0;
 		}
 	}
-  return 0;
+  std::cout << "# Goodput of all connections: " << goodput << " Kbps." << std::endl;
 }
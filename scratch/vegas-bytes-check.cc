@@ -0,0 +1,279 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Checks the bytes TcpNewVegas counts as sent since a segment left, and
+ * the Diff it derives from them, against the per-node accumulation the
+ * Vegas list used to do, on an ACK trace. Each send is recorded in the
+ * sent segment table as TcpSocketBase does and added to every node of
+ * the old list; each ACK advancing the window looks up the segment it
+ * ends, as TcpNewVegas::EstimateDiff does, then discards up to it.
+ *
+ * The trace has one event per line, the time in ms first:
+ *   <time> S <seq> <size>  segment [seq, seq + size) sent
+ *   <time> A <ack> <cwnd>  ACK received, with the cwnd at that time
+ * Lines starting with '#' are ignored. Without --trace, a recorded trace
+ * of slow start, delayed ACKs and one fast retransmission is replayed.
+ *
+ * Exits with status 1 if the byte counts or the Diff values differ.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <list>
+#include "ns3/core-module.h"
+#include "ns3/tcp-sent-segment-table.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("VegasBytesCheck");
+
+/* 536-byte segments from sequence number 1, cwnd in bytes */
+static const char *g_trace =
+  "0 S 1 536\n"
+  "0 S 537 536\n"
+  "100 A 1073 1608\n"
+  "100 S 1073 536\n"
+  "100 S 1609 536\n"
+  "100 S 2145 536\n"
+  "200 A 1609 2144\n"
+  "200 S 2681 536\n"
+  "200 S 3217 536\n"
+  "201 A 2681 2680\n"
+  "201 S 3753 536\n"
+  "201 S 4289 536\n"
+  "201 S 4825 536\n"
+  "300 A 3217 3216\n"
+  "300 S 5361 536\n"
+  "300 S 5897 536\n"
+  "301 A 3753 3752\n"
+  "301 S 6433 536\n"
+  "301 S 6969 536\n"
+  "# 3753 is lost: duplicate ACKs, then its fast retransmission\n"
+  "302 A 3753 3752\n"
+  "303 A 3753 3752\n"
+  "304 A 3753 3752\n"
+  "304 S 3753 536\n"
+  "305 A 3753 2144\n"
+  "306 A 3753 2144\n"
+  "405 A 5897 2144\n"
+  "405 S 7505 536\n"
+  "405 S 8041 536\n"
+  "406 A 6969 2680\n"
+  "406 S 8577 536\n"
+  "406 S 9113 536\n"
+  "506 A 8041 3216\n"
+  "506 S 9649 536\n"
+  "506 S 10185 536\n"
+  "507 A 9113 3752\n"
+  "507 S 10721 536\n"
+  "507 S 11257 536\n"
+  "608 A 10185 3752\n"
+  "609 A 11257 3752\n"
+  "610 A 11793 3752\n";
+
+/* The per-node accumulation VegasList did before the running counter */
+class OldVegasList
+{
+public:
+  struct Node
+  {
+    SequenceNumber32 seq;
+    Time sentTime;
+    uint32_t bytes;
+  };
+
+  void Sent (SequenceNumber32 seq, uint32_t size)
+  {
+    SequenceNumber32 end = seq + SequenceNumber32 (size);
+    bool found = false;
+    for (std::list<Node>::iterator i = m_data.begin (); i != m_data.end (); i++)
+      {
+        found = found || (*i).seq == end;
+      }
+    if (!found)
+      { // A retransmission keeps the node of the first transmission
+        Node node = { end, Simulator::Now (), 0 };
+        m_data.push_back (node);
+      }
+    for (std::list<Node>::iterator i = m_data.begin (); i != m_data.end (); i++)
+      {
+        (*i).bytes += size;
+      }
+  }
+  const Node *Find (SequenceNumber32 seq) const
+  {
+    for (std::list<Node>::const_iterator i = m_data.begin (); i != m_data.end (); i++)
+      {
+        if ((*i).seq == seq)
+          {
+            return &*i;
+          }
+      }
+    return 0;
+  }
+  void DiscardUpTo (SequenceNumber32 seq)
+  {
+    std::list<Node>::iterator i = m_data.begin ();
+    while (i != m_data.end ())
+      {
+        if ((*i).seq <= seq)
+          {
+            i = m_data.erase (i);
+          }
+        else
+          {
+            i++;
+          }
+      }
+  }
+private:
+  std::list<Node> m_data;
+};
+
+/* TcpNewVegas::EstimateDiff on the RTT and bytes of the acknowledged segment */
+class Estimator
+{
+public:
+  Estimator (uint32_t segmentSize) : m_segmentSize (segmentSize), m_baseRTT (9999999999) {}
+
+  double Diff (Time rtt, uint32_t bytes, uint32_t cWnd)
+  {
+    int64_t lastRTT = rtt.GetInteger ();
+    if (bytes <= m_segmentSize || lastRTT < m_baseRTT)
+      {
+        m_baseRTT = lastRTT;
+      }
+    double actual = static_cast<double> (cWnd) / lastRTT;
+    double expected = static_cast<double> (cWnd) / m_baseRTT;
+    return (expected - actual) * m_baseRTT / m_segmentSize;
+  }
+private:
+  uint32_t m_segmentSize;
+  int64_t m_baseRTT;
+};
+
+struct Check
+{
+  Check (uint32_t segmentSize)
+    : oldDiff (segmentSize), newDiff (segmentSize), acks (0), failures (0) {}
+
+  OldVegasList old;
+  TcpSentSegmentTable table;
+  Estimator oldDiff;
+  Estimator newDiff;
+  SequenceNumber32 highAck;
+  uint32_t acks;
+  uint32_t failures;
+};
+
+static void
+Send (Check *c, SequenceNumber32 seq, uint32_t size)
+{
+  c->old.Sent (seq, size);
+  c->table.Sent (seq, size);
+}
+
+static void
+Ack (Check *c, SequenceNumber32 ack, uint32_t cWnd)
+{
+  if (ack <= c->highAck)
+    { // Duplicate ACK: no estimate
+      return;
+    }
+  c->highAck = ack;
+  const OldVegasList::Node *node = c->old.Find (ack);
+  uint32_t i = c->table.Find (ack);
+  if ((node == 0) != (i == c->table.Size ()))
+    {
+      std::cout << "ACK " << ack << ": segment found in only one of the lists" << std::endl;
+      c->failures++;
+    }
+  else if (node != 0)
+    {
+      Time rtt = Simulator::Now () - c->table.GetFirstSentTime (i);
+      uint32_t bytes = c->table.GetBytesSent () - c->table.GetBytesSentSnapshot (i);
+      double oldDiff = c->oldDiff.Diff (Simulator::Now () - node->sentTime, node->bytes, cWnd);
+      double newDiff = c->newDiff.Diff (rtt, bytes, cWnd);
+      std::cout << Simulator::Now ().GetMilliSeconds () << " ms, ACK " << ack
+                << ": bytes " << node->bytes << " / " << bytes
+                << ", Diff " << oldDiff << " / " << newDiff << std::endl;
+      if (bytes != node->bytes || oldDiff != newDiff)
+        {
+          c->failures++;
+        }
+      c->acks++;
+    }
+  c->old.DiscardUpTo (ack);
+  c->table.DiscardUpTo (ack);
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string trace = "";
+  uint32_t segSize = 536;
+
+  CommandLine cmd;
+  cmd.AddValue ("trace", "ACK trace to replay, empty for the recorded one", trace);
+  cmd.AddValue ("segSize", "Segment size of the trace, in bytes", segSize);
+  cmd.Parse (argc, argv);
+
+  std::istringstream recorded (g_trace);
+  std::ifstream file;
+  if (!trace.empty ())
+    {
+      file.open (trace.c_str ());
+      NS_ABORT_MSG_UNLESS (file, "Cannot open " << trace);
+    }
+  std::istream &in = trace.empty () ? static_cast<std::istream &> (recorded) : file;
+
+  Check c (segSize);
+  std::string line;
+  while (std::getline (in, line))
+    {
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      std::istringstream fields (line);
+      double ms;
+      std::string event;
+      uint32_t seq;
+      uint32_t value;
+      fields >> ms >> event >> seq >> value;
+      NS_ABORT_MSG_UNLESS (fields && (event == "S" || event == "A"), "Bad trace line: " << line);
+      if (event == "S")
+        {
+          Simulator::Schedule (Seconds (ms / 1000), &Send, &c, SequenceNumber32 (seq), value);
+        }
+      else
+        {
+          Simulator::Schedule (Seconds (ms / 1000), &Ack, &c, SequenceNumber32 (seq), value);
+        }
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::cout << "ACKs estimated\t" << c.acks << std::endl;
+  if (c.failures > 0)
+    {
+      std::cout << "FAIL: " << c.failures << " ACKs differ" << std::endl;
+      return 1;
+    }
+  std::cout << "PASS" << std::endl;
+  return 0;
+}
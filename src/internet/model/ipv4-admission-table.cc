@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ipv4-admission-table.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("Ipv4AdmissionTable");
+
+namespace ns3 {
+
+Ipv4AdmissionTable::Ipv4AdmissionTable (void)
+  : m_built (true)
+{
+}
+
+void
+Ipv4AdmissionTable::Add (Ipv4Address network, Ipv4Mask mask, uint16_t portLow, uint16_t portHigh,
+                         const Address &value)
+{
+  NS_LOG_FUNCTION (this << network << mask << portLow << portHigh << value);
+  NS_ASSERT (portLow <= portHigh);
+  Rule rule;
+  rule.network = network.Get () & mask.Get ();
+  rule.portLow = portLow;
+  rule.portHigh = portHigh;
+  rule.value = m_values.size ();
+  m_rules.push_back (rule);
+  m_lengths.push_back (mask.GetPrefixLength ());
+  m_values.push_back (value);
+  m_built = false;
+}
+
+bool
+Ipv4AdmissionTable::Before (const Rule &a, const Rule &b)
+{
+  return a.network < b.network || (a.network == b.network && a.portLow < b.portLow);
+}
+
+void
+Ipv4AdmissionTable::Build (void)
+{
+  NS_LOG_FUNCTION (this);
+  // Counting sort by decreasing prefix length, then sort each group
+  std::vector<uint32_t> count (33, 0);
+  for (uint32_t i = 0; i < m_rules.size (); ++i)
+    {
+      count[m_lengths[i]]++;
+    }
+  std::vector<uint32_t> next (33, 0);
+  m_groups.clear ();
+  uint32_t begin = 0;
+  for (int length = 32; length >= 0; --length)
+    {
+      next[length] = begin;
+      if (count[length] > 0)
+        {
+          Group group;
+          group.mask = length == 0 ? 0 : 0xffffffff << (32 - length);
+          group.begin = begin;
+          group.end = begin + count[length];
+          m_groups.push_back (group);
+          begin = group.end;
+        }
+    }
+  std::vector<Rule> rules (m_rules.size ());
+  std::vector<uint8_t> lengths (m_rules.size ());
+  for (uint32_t i = 0; i < m_rules.size (); ++i)
+    {
+      uint32_t k = next[m_lengths[i]]++;
+      rules[k] = m_rules[i];
+      lengths[k] = m_lengths[i];
+    }
+  m_rules.swap (rules);
+  m_lengths.swap (lengths);
+
+  for (std::vector<Group>::const_iterator g = m_groups.begin (); g != m_groups.end (); ++g)
+    {
+      std::sort (m_rules.begin () + g->begin, m_rules.begin () + g->end, &Ipv4AdmissionTable::Before);
+      for (uint32_t i = g->begin + 1; i < g->end; ++i)
+        {
+          NS_ABORT_MSG_IF (m_rules[i].network == m_rules[i - 1].network
+                           && m_rules[i].portLow <= m_rules[i - 1].portHigh,
+                           "Overlapping port ranges for " << Ipv4Address (m_rules[i].network)
+                           << " (" << m_rules[i].portLow << "-" << m_rules[i].portHigh << ")");
+        }
+    }
+  NS_LOG_LOGIC (m_rules.size () << " rules in " << m_groups.size () << " prefix lengths");
+  m_built = true;
+}
+
+bool
+Ipv4AdmissionTable::Lookup (Ipv4Address address, uint16_t port, Address &value) const
+{
+  NS_LOG_FUNCTION (this << address << port);
+  NS_ASSERT_MSG (m_built, "Rules added since the last Build ()");
+  Rule key;
+  key.portLow = port;
+  for (std::vector<Group>::const_iterator g = m_groups.begin (); g != m_groups.end (); ++g)
+    {
+      key.network = address.Get () & g->mask;
+      // The last rule starting at or before (network, port) is the only candidate
+      std::vector<Rule>::const_iterator i = std::upper_bound (m_rules.begin () + g->begin,
+                                                              m_rules.begin () + g->end,
+                                                              key, &Ipv4AdmissionTable::Before);
+      if (i != m_rules.begin () + g->begin)
+        {
+          --i;
+          if (i->network == key.network && port <= i->portHigh)
+            {
+              value = m_values[i->value];
+              return true;
+            }
+        }
+    }
+  return false;
+}
+
+uint32_t
+Ipv4AdmissionTable::GetNRules (void) const
+{
+  return m_rules.size ();
+}
+
+Address
+Ipv4AdmissionTable::GetValue (uint32_t i) const
+{
+  return m_values[m_rules[i].value];
+}
+
+} // namespace ns3
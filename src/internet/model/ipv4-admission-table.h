@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef IPV4_ADMISSION_TABLE_H
+#define IPV4_ADMISSION_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/address.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Rules matching an IPv4 address and port, longest prefix first
+ *
+ * Each rule covers an address prefix and a range of ports and carries
+ * an Address (e.g. where a proxy sends the connections it admits). A
+ * lookup returns the rule with the longest prefix among those matching
+ * the address and whose range holds the port.
+ *
+ * Rules are added first, then Build () lays them out as one flat
+ * vector, grouped by decreasing prefix length and sorted by network and
+ * first port inside a group. A lookup masks the address once per prefix
+ * length in use and binary searches that group, i.e. at most 33 binary
+ * searches whatever the number of rules. The port ranges of rules with
+ * the same prefix must not overlap.
+ */
+class Ipv4AdmissionTable
+{
+public:
+  Ipv4AdmissionTable (void);
+
+  /**
+   * \brief Add a rule, taken into account at the next Build ()
+   * \param network address prefix
+   * \param mask prefix mask
+   * \param portLow first port of the range
+   * \param portHigh last port of the range
+   * \param value the Address the rule carries
+   */
+  void Add (Ipv4Address network, Ipv4Mask mask, uint16_t portLow, uint16_t portHigh, const Address &value);
+
+  /**
+   * \brief Sort the rules for lookups
+   */
+  void Build (void);
+
+  /**
+   * \brief Find the rule matching an address and port
+   * \param address the address
+   * \param port the port
+   * \param value the Address of the rule, if found
+   * \returns true if a rule matches
+   */
+  bool Lookup (Ipv4Address address, uint16_t port, Address &value) const;
+
+  uint32_t GetNRules (void) const;          //!< Number of rules added
+  Address GetValue (uint32_t i) const;      //!< Address carried by the rule at index i (in build order)
+
+private:
+  /// A rule, as laid out for lookups
+  struct Rule
+  {
+    uint32_t network;  //!< masked address prefix
+    uint16_t portLow;  //!< first port of the range
+    uint16_t portHigh; //!< last port of the range
+    uint32_t value;    //!< index of the Address in m_values
+  };
+  /// The rules of one prefix length
+  struct Group
+  {
+    uint32_t mask;  //!< mask of the prefix length
+    uint32_t begin; //!< first rule of the group
+    uint32_t end;   //!< rule following the group
+  };
+
+  static bool Before (const Rule &a, const Rule &b); //!< Order of the rules in a group
+
+  std::vector<Rule> m_rules;      //!< rules, by group
+  std::vector<uint8_t> m_lengths; //!< prefix length of each rule
+  std::vector<Group> m_groups;    //!< groups, longest prefixes first
+  std::vector<Address> m_values;  //!< addresses carried by the rules
+  bool m_built;                   //!< no rule was added since Build ()
+};
+
+} // namespace ns3
+
+#endif /* IPV4_ADMISSION_TABLE_H */
@@ -0,0 +1,619 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#define NS_LOG_APPEND_CONTEXT \
+  if (m_node) { std::clog << Simulator::Now ().GetSeconds () << " [node " << m_node->GetId () << "] "; }
+
+#include "tcp-bbr.h"
+#include "ns3/log.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/simulator.h"
+#include "ns3/abort.h"
+#include "ns3/node.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+
+NS_LOG_COMPONENT_DEFINE ("TcpBbr");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (TcpBbr)
+  ;
+
+/* Pacing gains of the PROBE_BW cycle: probe for more, drain the queue
+ * probing made, then cruise */
+static const uint32_t BBR_CYCLE_LEN = 8;
+static const double BBR_CYCLE_GAIN[BBR_CYCLE_LEN] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+TypeId
+TcpBbr::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpBbr")
+    .SetParent<TcpSocketBase> ()
+    .AddConstructor<TcpBbr> ()
+    .AddAttribute ("ReTxThreshold", "Threshold for fast retransmit",
+                    UintegerValue (3),
+                    MakeUintegerAccessor (&TcpBbr::m_retxThresh),
+                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("HighGain",
+                   "Pacing and cwnd gain in STARTUP, 2/ln(2) to double the delivery rate every round",
+                    DoubleValue (2.885),
+                    MakeDoubleAccessor (&TcpBbr::m_highGain),
+                    MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("CwndGain",
+                   "cwnd gain over the estimated BDP, out of STARTUP",
+                    DoubleValue (2.0),
+                    MakeDoubleAccessor (&TcpBbr::m_cwndGain),
+                    MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("BwWindow",
+                   "Number of rounds of the bottleneck bandwidth filter",
+                    UintegerValue (10),
+                    MakeUintegerAccessor (&TcpBbr::m_bwWindow),
+                    MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MinRttWindow",
+                   "Duration of the min RTT filter, after which PROBE_RTT is entered",
+                    TimeValue (Seconds (10)),
+                    MakeTimeAccessor (&TcpBbr::m_minRttWindow),
+                    MakeTimeChecker ())
+    .AddAttribute ("ProbeRttDuration",
+                   "Minimum time spent with 4 segments in flight in PROBE_RTT",
+                    TimeValue (MilliSeconds (200)),
+                    MakeTimeAccessor (&TcpBbr::m_probeRttDuration),
+                    MakeTimeChecker ())
+    .AddTraceSource ("CongestionWindow",
+                     "The TCP connection's congestion window",
+                     MakeTraceSourceAccessor (&TcpBbr::m_cWnd))
+    .AddTraceSource ("Mode",
+                     "Phase of the BBR state machine (BbrMode_t)",
+                     MakeTraceSourceAccessor (&TcpBbr::m_mode))
+    .AddTraceSource ("BottleneckBandwidth",
+                     "Windowed maximum of the delivery rate",
+                     MakeTraceSourceAccessor (&TcpBbr::m_btlBw))
+    .AddTraceSource ("MinRtt",
+                     "Windowed minimum of the RTT",
+                     MakeTraceSourceAccessor (&TcpBbr::m_minRtt))
+  ;
+  return tid;
+}
+
+TcpBbr::TcpBbr (void)
+  : m_retxThresh (3), // mute valgrind, actual value set by the attribute system
+    m_inFastRec (false),
+    m_highGain (2.885),
+    m_cwndGain (2.0),
+    m_bwWindow (10),
+    m_minRttWindow (Seconds (10)),
+    m_probeRttDuration (MilliSeconds (200)),
+    m_cycleStart (CreateObject<UniformRandomVariable> ())
+{
+  NS_LOG_FUNCTION (this);
+  BbrReset ();
+}
+
+TcpBbr::TcpBbr (const TcpBbr& sock)
+  : TcpSocketBase (sock),
+    m_cWnd (sock.m_cWnd),
+    m_ssThresh (sock.m_ssThresh),
+    m_initialCWnd (sock.m_initialCWnd),
+    m_retxThresh (sock.m_retxThresh),
+    m_inFastRec (false),
+    m_highGain (sock.m_highGain),
+    m_cwndGain (sock.m_cwndGain),
+    m_bwWindow (sock.m_bwWindow),
+    m_minRttWindow (sock.m_minRttWindow),
+    m_probeRttDuration (sock.m_probeRttDuration),
+    m_cycleStart (CreateObject<UniformRandomVariable> ())
+{
+  NS_LOG_FUNCTION (this);
+  NS_LOG_LOGIC ("Invoked the copy constructor");
+  BbrReset ();
+}
+
+TcpBbr::~TcpBbr (void)
+{
+}
+
+/** We initialize m_cWnd from this function, after attributes initialized */
+int
+TcpBbr::Listen (void)
+{
+  NS_LOG_FUNCTION (this);
+  InitializeCwnd ();
+  return TcpSocketBase::Listen ();
+}
+
+/** We initialize m_cWnd from this function, after attributes initialized */
+int
+TcpBbr::Connect (const Address & address)
+{
+  NS_LOG_FUNCTION (this << address);
+  InitializeCwnd ();
+  return TcpSocketBase::Connect (address);
+}
+
+/** Limit the size of in-flight data by cwnd and receiver's rxwin */
+uint32_t
+TcpBbr::Window (void)
+{
+  NS_LOG_FUNCTION (this);
+  return std::min (m_rWnd.Get (), m_cWnd.Get ());
+}
+
+Ptr<TcpSocketBase>
+TcpBbr::Fork (void)
+{
+  return CopyObject<TcpBbr> (this);
+}
+
+/** New ACK (up to seqnum seq) received. Update the model and cwnd, then call TcpSocketBase::NewAck() */
+void
+TcpBbr::NewAck (const SequenceNumber32& seq)
+{
+  NS_LOG_FUNCTION (this << seq);
+  uint32_t acked = seq - m_txBuffer.HeadSequence ();
+  uint32_t priorInFlight = BytesInFlight ();
+  uint32_t inFlight = priorInFlight - std::min (priorInFlight, acked);
+  uint32_t delivered = m_sentTable.GetDelivered ();
+
+  // TcpSocketBase took the rate sample of this ACK
+  bool roundStart = false;
+  if (m_rateSample.interval.IsStrictlyPositive ())
+    {
+      if (static_cast<int32_t> (m_rateSample.priorDelivered - m_nextRoundDelivered) >= 0)
+        { // Sent after the round started: the round is over
+          roundStart = true;
+          m_round++;
+          m_nextRoundDelivered = delivered;
+        }
+      UpdateBandwidth ();
+    }
+  UpdateCycle (priorInFlight);
+  CheckFullBandwidth (roundStart);
+  CheckDrain (inFlight);
+  UpdateMinRtt (roundStart, inFlight, delivered);
+  UpdatePacingRate ();
+
+  if (m_inFastRec && m_sackRecovery)
+    { // Partial ACK in SACK recovery: the pipe estimate paces the retransmissions
+    }
+  else if (m_inFastRec)
+    { // Recovery over: back to the cwnd it started with
+      m_inFastRec = false;
+      m_cWnd = std::max (m_cWnd.Get (), m_priorCwnd);
+      NS_LOG_INFO ("Recovery over, cwnd " << m_cWnd);
+    }
+  else
+    {
+      UpdateCwnd (acked);
+    }
+
+  // Complete newAck processing
+  TcpSocketBase::NewAck (seq);
+}
+
+/** Enter fast recovery upon triple dupack, holding cwnd to the data in flight */
+void
+TcpBbr::DupAck (const TcpHeader& t, uint32_t count)
+{
+  NS_LOG_FUNCTION (this << "t " << count);
+  if (count == m_retxThresh && !m_inFastRec)
+    { // Losses leave the model alone; only the data in flight is held (packet conservation)
+      m_priorCwnd = (m_mode == BBR_PROBE_RTT) ? std::max (m_priorCwnd, m_cWnd.Get ()) : m_cWnd.Get ();
+      m_cWnd = std::max (std::min (m_cWnd.Get (), BytesInFlight ()), MinCwnd ());
+      m_inFastRec = true;
+      NS_LOG_INFO ("Triple dupack. Hold cwnd at " << m_cWnd);
+      FastRetransmit ();
+    }
+  else if (m_inFastRec)
+    { // In fast recovery, a segment leaves for every one that arrives
+      if (!m_sackRecovery)
+        {
+          m_cWnd += m_segmentSize;
+          NS_LOG_INFO ("Increased cwnd to " << m_cWnd);
+        }
+      SendPendingData (m_connected);
+    }
+}
+
+/** Retransmit timeout */
+void
+TcpBbr::Retransmit (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_LOG_LOGIC (this << " ReTxTimeout Expired at time " << Simulator::Now ().GetSeconds ());
+  m_inFastRec = false;
+
+  // If erroneous timeout in closed/timed-wait state, just return
+  if (m_state == CLOSED || m_state == TIME_WAIT) return;
+  // If all data are received (non-closing socket and nothing to send), just return
+  if (m_state <= ESTABLISHED && m_txBuffer.HeadSequence () >= m_highTxMark) return;
+
+  // Nothing is known to be in flight: restart from one segment, the model
+  // lets cwnd grow back by the data acknowledged
+  m_priorCwnd = m_cWnd.Get ();
+  m_cWnd = m_segmentSize;
+  m_nextTxSequence = m_txBuffer.HeadSequence (); // Restart from highest Ack
+  NS_LOG_INFO ("RTO. Reset cwnd to " << m_cWnd << ", restart from seqnum " << m_nextTxSequence);
+  m_rtt->IncreaseMultiplier ();             // Double the next RTO
+  DoRetransmit ();                          // Retransmit the packet
+}
+
+DataRate
+TcpBbr::GetPacingRate (void)
+{
+  if (m_pacingRate.GetBitRate () == 0)
+    { // No bandwidth sample yet: the initial window per RTT, at the startup gain
+      return WindowRate (m_highGain);
+    }
+  return m_pacingRate;
+}
+
+void
+TcpBbr::SetSegSize (uint32_t size)
+{
+  NS_ABORT_MSG_UNLESS (m_state == CLOSED, "TcpBbr::SetSegSize() cannot change segment size after connection started.");
+  m_segmentSize = size;
+}
+
+void
+TcpBbr::SetSSThresh (uint32_t threshold)
+{
+  m_ssThresh = threshold;
+}
+
+uint32_t
+TcpBbr::GetSSThresh (void) const
+{
+  return m_ssThresh;
+}
+
+void
+TcpBbr::SetInitialCwnd (uint32_t cwnd)
+{
+  NS_ABORT_MSG_UNLESS (m_state == CLOSED, "TcpBbr::SetInitialCwnd() cannot change initial cwnd after connection started.");
+  m_initialCWnd = cwnd;
+}
+
+uint32_t
+TcpBbr::GetInitialCwnd (void) const
+{
+  return m_initialCWnd;
+}
+
+void
+TcpBbr::InitializeCwnd (void)
+{
+  m_cWnd = m_initialCWnd * m_segmentSize;
+  m_pacing = true;
+}
+
+void
+TcpBbr::BbrReset (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_priorCwnd = 0;
+  m_mode = BBR_STARTUP;
+  m_pacingGainNow = m_highGain;
+  m_cwndGainNow = m_highGain;
+  ResetMaxFilter (m_bwFilter, 0, 0);
+  m_btlBw = DataRate (0);
+  m_minRtt = Time ();
+  m_minRttStamp = Simulator::Now ();
+  m_round = 0;
+  m_nextRoundDelivered = 0;
+  m_fullBw = false;
+  m_fullBwValue = 0;
+  m_fullBwCount = 0;
+  m_cycleIndex = 0;
+  m_cycleStamp = Time ();
+  m_probeRttDone = Time ();
+  m_probeRttRoundDone = false;
+  m_pacingRate = DataRate (0);
+}
+
+void
+TcpBbr::UpdateBandwidth (void)
+{
+  uint64_t bw = m_deliveryRate.GetBitRate ();
+  if (m_rateSample.appLimited && bw < m_btlBw.Get ().GetBitRate ())
+    { // The application, not the path, held the rate down
+      return;
+    }
+  m_btlBw = DataRate (UpdateMaxFilter (m_bwFilter, m_bwWindow, m_round, bw));
+  NS_LOG_LOGIC ("Delivery rate " << bw << " bps, bottleneck bandwidth " << m_btlBw.Get ().GetBitRate ());
+}
+
+/*
+ * PROBE_BW moves to the next phase after a min RTT, except that the
+ * probing phase also waits for the extra data to be in flight (or a loss),
+ * and the draining phase ends as soon as no more than a BDP is in flight.
+ */
+void
+TcpBbr::UpdateCycle (uint32_t priorInFlight)
+{
+  if (m_mode != BBR_PROBE_BW)
+    {
+      return;
+    }
+  Time now = Simulator::Now ();
+  bool fullLength = now - m_cycleStamp > m_minRtt.Get ();
+  bool advance;
+  if (m_pacingGainNow > 1.0)
+    {
+      advance = fullLength && (m_inFastRec || priorInFlight >= Bdp (m_pacingGainNow));
+    }
+  else if (m_pacingGainNow < 1.0)
+    {
+      advance = fullLength || priorInFlight <= Bdp (1.0);
+    }
+  else
+    {
+      advance = fullLength;
+    }
+  if (advance)
+    {
+      m_cycleIndex = (m_cycleIndex + 1) % BBR_CYCLE_LEN;
+      m_cycleStamp = now;
+      m_pacingGainNow = BBR_CYCLE_GAIN[m_cycleIndex];
+      NS_LOG_LOGIC ("PROBE_BW phase " << m_cycleIndex << ", pacing gain " << m_pacingGainNow);
+    }
+}
+
+void
+TcpBbr::CheckFullBandwidth (bool roundStart)
+{
+  if (m_fullBw || !roundStart || m_rateSample.appLimited)
+    {
+      return;
+    }
+  uint64_t bw = m_btlBw.Get ().GetBitRate ();
+  if (bw >= m_fullBwValue + m_fullBwValue / 4)
+    { // Still growing by 25% per round
+      m_fullBwValue = bw;
+      m_fullBwCount = 0;
+      return;
+    }
+  if (++m_fullBwCount >= 3)
+    {
+      NS_LOG_INFO ("Bandwidth plateau at " << bw << " bps");
+      m_fullBw = true;
+    }
+}
+
+void
+TcpBbr::CheckDrain (uint32_t inFlight)
+{
+  if (m_mode == BBR_STARTUP && m_fullBw)
+    {
+      NS_LOG_INFO ("Entering DRAIN");
+      m_mode = BBR_DRAIN;
+      m_pacingGainNow = 1.0 / m_highGain;
+      m_cwndGainNow = m_highGain;
+    }
+  if (m_mode == BBR_DRAIN && inFlight <= Bdp (1.0))
+    {
+      EnterProbeBw ();
+    }
+}
+
+/*
+ * The min RTT is refreshed by any sample at or below it, and replaced by
+ * the current sample once MinRttWindow passed. When it expires, PROBE_RTT
+ * cuts the data in flight to 4 segments so that the next samples see no
+ * queue, for ProbeRttDuration and at least a round.
+ */
+void
+TcpBbr::UpdateMinRtt (bool roundStart, uint32_t inFlight, uint32_t delivered)
+{
+  Time now = Simulator::Now ();
+  Time rtt = m_lastRtt.Get ();
+  bool expired = now > m_minRttStamp + m_minRttWindow;
+  if (rtt.IsStrictlyPositive () && (m_minRtt.Get ().IsZero () || rtt <= m_minRtt.Get () || expired))
+    {
+      m_minRtt = rtt;
+      m_minRttStamp = now;
+    }
+
+  if (expired && m_mode != BBR_PROBE_RTT)
+    {
+      NS_LOG_INFO ("Min RTT expired, entering PROBE_RTT");
+      m_priorCwnd = m_inFastRec ? m_priorCwnd : std::max (m_priorCwnd, m_cWnd.Get ());
+      m_mode = BBR_PROBE_RTT;
+      m_pacingGainNow = 1.0;
+      m_cwndGainNow = 1.0;
+      m_probeRttDone = Time ();
+    }
+  if (m_mode != BBR_PROBE_RTT)
+    {
+      return;
+    }
+  if (m_probeRttDone.IsZero ())
+    {
+      if (inFlight <= MinCwnd ())
+        { // Drained: hold for ProbeRttDuration and a full round from now
+          m_probeRttDone = now + m_probeRttDuration;
+          m_probeRttRoundDone = false;
+          m_nextRoundDelivered = delivered;
+        }
+      return;
+    }
+  if (roundStart)
+    {
+      m_probeRttRoundDone = true;
+    }
+  if (m_probeRttRoundDone && now >= m_probeRttDone)
+    {
+      m_minRttStamp = now;
+      m_cWnd = std::max (m_cWnd.Get (), m_priorCwnd);
+      EnterStartupOrProbeBw ();
+    }
+}
+
+/* Pace at the bandwidth times the gain, 1% below to keep the queue small.
+ * Until the plateau is found, the rate is never lowered. */
+void
+TcpBbr::UpdatePacingRate (void)
+{
+  uint64_t bw = m_btlBw.Get ().GetBitRate ();
+  if (bw == 0)
+    {
+      return;
+    }
+  DataRate rate (static_cast<uint64_t> (m_pacingGainNow * bw * 0.99));
+  if (m_fullBw || rate > m_pacingRate)
+    {
+      m_pacingRate = rate;
+    }
+}
+
+void
+TcpBbr::UpdateCwnd (uint32_t acked)
+{
+  uint32_t target = TargetCwnd ();
+  uint32_t cWnd = m_cWnd.Get ();
+  if (m_fullBw)
+    {
+      cWnd = std::min (cWnd + acked, target);
+    }
+  else if (cWnd < target || m_sentTable.GetDelivered () < m_initialCWnd * m_segmentSize)
+    { // STARTUP: grow with the data delivered
+      cWnd += acked;
+    }
+  cWnd = std::max (cWnd, MinCwnd ());
+  if (m_mode == BBR_PROBE_RTT)
+    {
+      cWnd = std::min (cWnd, MinCwnd ());
+    }
+  m_cWnd = cWnd;
+  NS_LOG_LOGIC ("cwnd " << m_cWnd << ", target " << target);
+}
+
+void
+TcpBbr::EnterProbeBw (void)
+{
+  // Start at a random phase, but not the draining one
+  m_mode = BBR_PROBE_BW;
+  m_cwndGainNow = m_cwndGain;
+  m_cycleIndex = (BBR_CYCLE_LEN - m_cycleStart->GetInteger (0, BBR_CYCLE_LEN - 2)) % BBR_CYCLE_LEN;
+  m_cycleStamp = Simulator::Now ();
+  m_pacingGainNow = BBR_CYCLE_GAIN[m_cycleIndex];
+  NS_LOG_INFO ("Entering PROBE_BW at phase " << m_cycleIndex);
+}
+
+void
+TcpBbr::EnterStartupOrProbeBw (void)
+{
+  if (m_fullBw)
+    {
+      EnterProbeBw ();
+    }
+  else
+    {
+      NS_LOG_INFO ("Back to STARTUP");
+      m_mode = BBR_STARTUP;
+      m_pacingGainNow = m_highGain;
+      m_cwndGainNow = m_highGain;
+    }
+}
+
+uint32_t
+TcpBbr::Bdp (double gain) const
+{
+  return static_cast<uint32_t> (gain * m_btlBw.Get ().GetBitRate () / 8 * m_minRtt.Get ().GetSeconds ());
+}
+
+uint32_t
+TcpBbr::TargetCwnd (void) const
+{
+  if (m_btlBw.Get ().GetBitRate () == 0 || m_minRtt.Get ().IsZero ())
+    {
+      return m_initialCWnd * m_segmentSize;
+    }
+  // Room for the segments the receiver's delayed ACKs hold back
+  return Bdp (m_cwndGainNow) + 3 * m_segmentSize;
+}
+
+uint32_t
+TcpBbr::MinCwnd (void) const
+{
+  return 4 * m_segmentSize;
+}
+
+void
+TcpBbr::ResetMaxFilter (MaxFilter &filter, uint32_t round, uint64_t value)
+{
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      filter.round[i] = round;
+      filter.value[i] = value;
+    }
+}
+
+/*
+ * Kathleen Nichols' windowed max: the best, second best and third best
+ * samples of disjoint sub-windows are kept, so that the max of the window
+ * is known in O(1) and a sample expiring is replaced by the next best.
+ */
+uint64_t
+TcpBbr::UpdateMaxFilter (MaxFilter &filter, uint32_t window, uint32_t round, uint64_t value)
+{
+  if (value >= filter.value[0] || round - filter.round[2] > window)
+    { // New max, or nothing left in the window
+      ResetMaxFilter (filter, round, value);
+      return value;
+    }
+  if (value >= filter.value[1])
+    {
+      filter.round[1] = filter.round[2] = round;
+      filter.value[1] = filter.value[2] = value;
+    }
+  else if (value >= filter.value[2])
+    {
+      filter.round[2] = round;
+      filter.value[2] = value;
+    }
+
+  uint32_t dt = round - filter.round[0];
+  if (dt > window)
+    { // The best sample expired: the next best take over
+      filter.round[0] = filter.round[1];
+      filter.value[0] = filter.value[1];
+      filter.round[1] = filter.round[2];
+      filter.value[1] = filter.value[2];
+      filter.round[2] = round;
+      filter.value[2] = value;
+      if (round - filter.round[0] > window)
+        {
+          filter.round[0] = filter.round[1];
+          filter.value[0] = filter.value[1];
+          filter.round[1] = filter.round[2];
+          filter.value[1] = filter.value[2];
+        }
+    }
+  else if (filter.round[1] == filter.round[0] && dt > window / 4)
+    { // A quarter of the window passed: keep a second best from now on
+      filter.round[1] = filter.round[2] = round;
+      filter.value[1] = filter.value[2] = value;
+    }
+  else if (filter.round[2] == filter.round[1] && dt > window / 2)
+    { // Half of the window passed: keep a third best from now on
+      filter.round[2] = round;
+      filter.value[2] = value;
+    }
+  return filter.value[0];
+}
+
+} // namespace ns3
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TCP_BBR_H
+#define TCP_BBR_H
+
+#include "tcp-socket-base.h"
+#include "ns3/traced-value.h"
+#include "ns3/random-variable-stream.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup socket
+ * \ingroup tcp
+ *
+ * \brief An implementation of a stream socket using TCP.
+ *
+ * This class contains the BBR congestion control (Cardwell et al., 2016),
+ * as in Linux tcp_bbr.c. BBR keeps a model of the path: the bottleneck
+ * bandwidth, the windowed maximum of the delivery rate over the last
+ * BwWindow rounds, and the propagation delay, the windowed minimum of the
+ * RTT over the last MinRttWindow. It paces at the bandwidth times a gain
+ * and bounds the data in flight by a multiple of their product (BDP).
+ *
+ * - STARTUP paces at HighGain (2/ln 2) until the bandwidth grew by less
+ *   than 25% for three rounds.
+ * - DRAIN paces at 1/HighGain until the data in flight is down to a BDP.
+ * - PROBE_BW cycles the pacing gain through 5/4, 3/4 and six times 1,
+ *   one phase per minimum RTT.
+ * - PROBE_RTT, when the minimum RTT was not refreshed for MinRttWindow,
+ *   holds 4 segments in flight for ProbeRttDuration and a round.
+ *
+ * The delivery rate samples are those TcpSocketBase takes on every new
+ * ACK. Samples limited by the application only count when they raise the
+ * estimate. A round ends when a segment sent after the start of the round
+ * is acknowledged.
+ *
+ * Losses do not reduce the model. Fast recovery holds cwnd to the data
+ * in flight (packet conservation) and restores it when recovery ends; a
+ * retransmission timeout drops it to one segment.
+ *
+ * BBR needs pacing: it is enabled when the connection starts, whatever
+ * the Pacing attribute.
+ */
+class TcpBbr : public TcpSocketBase
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Phases of the BBR state machine
+   */
+  enum BbrMode_t
+  {
+    BBR_STARTUP = 0, //!< Ramp up to fill the pipe
+    BBR_DRAIN,       //!< Drain the queue created in startup
+    BBR_PROBE_BW,    //!< Cycle the pacing gain around the bandwidth
+    BBR_PROBE_RTT    //!< Empty the queue to measure the propagation delay
+  };
+
+  /**
+   * Create an unbound tcp socket.
+   */
+  TcpBbr (void);
+  TcpBbr (const TcpBbr& sock);
+  virtual ~TcpBbr (void);
+
+  // From TcpSocketBase
+  virtual int Connect (const Address &address);
+  virtual int Listen (void);
+
+protected:
+  virtual uint32_t Window (void); // Return the max possible number of unacked bytes
+  virtual Ptr<TcpSocketBase> Fork (void); // Call CopyObject<TcpBbr> to clone me
+  virtual void NewAck (SequenceNumber32 const& seq); // Update the model and cwnd, call NewAck() of parent
+  virtual void DupAck (const TcpHeader& t, uint32_t count);  // Fast retransmit, packet conservation
+  virtual void Retransmit (void); // Retransmit timeout
+  virtual DataRate GetPacingRate (void); // Bandwidth estimate times the pacing gain
+
+  // Implementing ns3::TcpSocket -- Attribute get/set
+  virtual void     SetSegSize (uint32_t size);
+  virtual void     SetSSThresh (uint32_t threshold);
+  virtual uint32_t GetSSThresh (void) const;
+  virtual void     SetInitialCwnd (uint32_t cwnd);
+  virtual uint32_t GetInitialCwnd (void) const;
+
+private:
+  /// Windowed maximum of the delivery rate, as Linux lib/win_minmax.c
+  struct MaxFilter
+  {
+    uint32_t round[3];  //!< round of the best, second best and third best samples
+    uint64_t value[3];  //!< rates of those samples, in bit/s
+  };
+
+  void InitializeCwnd (void);                     // set m_cWnd when connection starts
+  void BbrReset (void);                           // reset the model and the state machine
+  void UpdateBandwidth (void);                    // new delivery rate sample
+  void UpdateCycle (uint32_t priorInFlight);      // PROBE_BW gain cycling
+  void CheckFullBandwidth (bool roundStart);      // STARTUP exit on bandwidth plateau
+  void CheckDrain (uint32_t inFlight);            // STARTUP -> DRAIN -> PROBE_BW
+  void UpdateMinRtt (bool roundStart, uint32_t inFlight, uint32_t delivered); // min RTT filter, PROBE_RTT
+  void UpdatePacingRate (void);                   // m_pacingRate from the bandwidth and gain
+  void UpdateCwnd (uint32_t acked);               // move cwnd toward the target
+  void EnterProbeBw (void);                       // start a gain cycle at a random phase
+  void EnterStartupOrProbeBw (void);              // leave PROBE_RTT
+  uint32_t Bdp (double gain) const;               // gain x bandwidth x min RTT, in bytes
+  uint32_t TargetCwnd (void) const;               // BDP x cwnd gain plus quantization budget
+  uint32_t MinCwnd (void) const;                  // 4 segments
+  static void ResetMaxFilter (MaxFilter &filter, uint32_t round, uint64_t value);
+  static uint64_t UpdateMaxFilter (MaxFilter &filter, uint32_t window, uint32_t round, uint64_t value);
+
+protected:
+  TracedValue<uint32_t>  m_cWnd;            //!< Congestion window
+  uint32_t               m_ssThresh;        //!< Slow Start Threshold, unused by BBR
+  uint32_t               m_initialCWnd;     //!< Initial cWnd value
+  uint32_t               m_retxThresh;      //!< Fast Retransmit threshold
+  bool                   m_inFastRec;       //!< currently in fast recovery
+  uint32_t               m_priorCwnd;       //!< cwnd before recovery or PROBE_RTT
+  TracedValue<BbrMode_t> m_mode;            //!< Phase of the state machine
+  double                 m_highGain;        //!< STARTUP pacing and cwnd gain
+  double                 m_cwndGain;        //!< cwnd gain in PROBE_BW
+  double                 m_pacingGainNow;   //!< Current pacing gain
+  double                 m_cwndGainNow;     //!< Current cwnd gain
+  uint32_t               m_bwWindow;        //!< Rounds of the bandwidth filter
+  Time                   m_minRttWindow;    //!< Duration of the min RTT filter
+  Time                   m_probeRttDuration; //!< Time spent at the minimum window in PROBE_RTT
+  MaxFilter              m_bwFilter;        //!< Delivery rate samples of the last rounds
+  TracedValue<DataRate>  m_btlBw;           //!< Bottleneck bandwidth estimate
+  TracedValue<Time>      m_minRtt;          //!< Propagation delay estimate
+  Time                   m_minRttStamp;     //!< Time m_minRtt was sampled
+  uint32_t               m_round;           //!< Count of rounds
+  uint32_t               m_nextRoundDelivered; //!< Delivered count ending the round
+  bool                   m_fullBw;          //!< STARTUP found the bandwidth plateau
+  uint64_t               m_fullBwValue;     //!< Bandwidth at the last 25% growth, in bit/s
+  uint32_t               m_fullBwCount;     //!< Rounds without 25% growth
+  uint32_t               m_cycleIndex;      //!< Phase of the PROBE_BW gain cycle
+  Time                   m_cycleStamp;      //!< Start of the phase
+  Time                   m_probeRttDone;    //!< End of PROBE_RTT, zero until the pipe drained
+  bool                   m_probeRttRoundDone; //!< A round passed in PROBE_RTT
+  DataRate               m_pacingRate;      //!< Rate set on the last ACK
+  Ptr<UniformRandomVariable> m_cycleStart;  //!< Draws the first PROBE_BW phase
+};
+
+} // namespace ns3
+
+#endif /* TCP_BBR_H */
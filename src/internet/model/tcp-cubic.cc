@@ -69,9 +69,27 @@ TcpCubic::GetTypeId (void)
                     DoubleValue (0.4),
                     MakeDoubleAccessor (&TcpCubic::m_c),
                     MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("FixedPoint",
+                   "Compute the cubic function with scaled integers instead of pow()",
+                    BooleanValue (false),
+                    MakeBooleanAccessor (&TcpCubic::m_fixedPoint),
+                    MakeBooleanChecker ())
+    .AddAttribute ("HyStart",
+                   "Leave slow start on ACK train length or delay increase (HyStart)",
+                    BooleanValue (false),
+                    MakeBooleanAccessor (&TcpCubic::m_hystart),
+                    MakeBooleanChecker ())
+    .AddAttribute ("HyStartLowWindow",
+                   "Number of segments of cwnd under which HyStart is not used",
+                    UintegerValue (16),
+                    MakeUintegerAccessor (&TcpCubic::m_hystartLowWindow),
+                    MakeUintegerChecker<uint32_t> ())
     .AddTraceSource ("CongestionWindow",
                      "The TCP connection's congestion window",
                      MakeTraceSourceAccessor (&TcpCubic::m_cWnd))
+    .AddTraceSource ("SlowStartExit",
+                     "Slow start ended: reason (SlowStartExit_t) and cwnd",
+                     MakeTraceSourceAccessor (&TcpCubic::m_slowStartExit))
   ;
   return tid;
 }
@@ -83,7 +101,10 @@ TcpCubic::TcpCubic (void)
     m_tcpFrndlyness (true),
     m_fastConv (true),
     m_beta (0.2),
-    m_c (0.4)
+    m_c (0.4),
+    m_fixedPoint (false),
+    m_hystart (false),
+    m_hystartLowWindow (16)
 {
   NS_LOG_FUNCTION (this);
   CubicReset ();
@@ -98,7 +119,10 @@ TcpCubic::TcpCubic (const TcpCubic& sock)
     m_tcpFrndlyness (sock.m_tcpFrndlyness),
     m_fastConv (sock.m_fastConv),
     m_beta (sock.m_beta),
-    m_c (sock.m_c)
+    m_c (sock.m_c),
+    m_fixedPoint (sock.m_fixedPoint),
+    m_hystart (sock.m_hystart),
+    m_hystartLowWindow (sock.m_hystartLowWindow)
 {
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC ("Invoked the copy constructor");
@@ -149,29 +173,24 @@ TcpCubic::NewAck (const SequenceNumber32& seq)
   NS_LOG_LOGIC ("TcpCubic receieved ACK for seq " << seq <<
                 " cwnd " << m_cWnd <<
                 " ssthresh " << m_ssThresh);
-  
+
+  if (m_inFastRec && m_sackRecovery)
+    { // Partial ACK in SACK recovery: cwnd is kept until the recovery ends
+      TcpSocketBase::NewAck (seq);
+      return;
+    }
+
   // Check for exit condition of fast recovery
   if (m_inFastRec)
     { // RFC2001, sec.4; RFC2581, sec.3.2
-      // First new ACK after fast recovery: reset cwnd
-	  m_epochStart = Time();
-	  uint32_t cWnd = m_cWnd.Get () / m_segmentSize;
-	  if (Simulator::Now () > m_wLastTime + 0.1 * m_k)
-		{
-		  if (cWnd < m_wLastMax && m_fastConv)
-			{
-			  m_wLastMax = cWnd * (2.0 - m_beta) / 2.0;
-			}
-		  else
-			{
-			  m_wLastMax = cWnd;
-			}
-		}
-	  m_wLastTime = Simulator::Now ();
-	  m_cWnd = m_cWnd.Get () * (1.0 - m_beta);
-      m_ssThresh = m_cWnd.Get ();
-      //m_cWnd = m_ssThresh;
+      // First new ACK after fast recovery: reset cwnd, unless SACK
+      // recovery already did when it started
+      if (!m_sackPermitted || m_prrActive)
+        {
+          CubicReduce ();
+        }
       m_inFastRec = false;
+      PrrStop ();
       NS_LOG_INFO ("Reset cwnd to " << m_cWnd);
     }
 
@@ -185,10 +204,14 @@ TcpCubic::NewAck (const SequenceNumber32& seq)
 	}
   
   // Increase of cwnd based on current phase (slow start or congestion avoidance)
-  if (m_cWnd <= m_ssThresh)
+  if (m_cWnd <= m_ssThresh && !(m_hystart && HyStartUpdate (seq)))
     { // Slow start mode, add one segSize to cWnd. Default m_ssThresh is 65535. (RFC2001, sec.1)
       m_cWnd += m_segmentSize;
       NS_LOG_INFO ("In SlowStart, updated to cwnd " << m_cWnd << " ssthresh " << m_ssThresh);
+      if (m_cWnd > m_ssThresh)
+        {
+          m_slowStartExit (SS_EXIT_THRESHOLD, m_cWnd.Get ());
+        }
     }
   else
 	{ // Congestion avoidance mode
@@ -215,16 +238,35 @@ TcpCubic::DupAck (const TcpHeader& t, uint32_t count)
   NS_LOG_FUNCTION (this << "t " << count);
   if (count == m_retxThresh && !m_inFastRec)
     { // triple duplicate ack triggers fast retransmit (RFC2581, sec.3.2)
+      if (m_cWnd < m_ssThresh && !m_hystartFound)
+        {
+          m_slowStartExit (SS_EXIT_LOSS, m_cWnd.Get ());
+        }
       m_ssThresh = std::max (2 * m_segmentSize, BytesInFlight () / 2);
-      m_cWnd = m_ssThresh + 3 * m_segmentSize;
+      if (m_prr)
+        { // Bring the data in flight down to the window the recovery ends with
+          PrrStart (std::max (2 * m_segmentSize, static_cast<uint32_t> (m_cWnd.Get () * (1.0 - m_beta))));
+        }
+      else if (m_sackPermitted)
+        { // cwnd = ssthresh (RFC 6675, sec.5 step 4.2); the pipe estimate
+          // accounts for the segments that left
+          CubicReduce ();
+        }
+      else
+        {
+          m_cWnd = m_ssThresh + 3 * m_segmentSize;
+        }
       m_inFastRec = true;
       NS_LOG_INFO ("Triple dupack. Reset cwnd to " << m_cWnd << ", ssthresh to " << m_ssThresh);
-      DoRetransmit ();
+      FastRetransmit ();
     }
   else if (m_inFastRec)
     { // In fast recovery, inc cwnd for every additional dupack (RFC2581, sec.3.2)
-      m_cWnd += m_segmentSize;
-      NS_LOG_INFO ("Increased cwnd to " << m_cWnd);
+      if (!m_sackRecovery && !m_prrActive)
+        {
+          m_cWnd += m_segmentSize;
+          NS_LOG_INFO ("Increased cwnd to " << m_cWnd);
+        }
       SendPendingData (m_connected);
     };
 }
@@ -236,6 +278,7 @@ TcpCubic::Retransmit (void)
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC (this << " ReTxTimeout Expired at time " << Simulator::Now ().GetSeconds ());
   m_inFastRec = false;
+  PrrStop ();
 
   // If erroneous timeout in closed/timed-wait state, just return
   if (m_state == CLOSED || m_state == TIME_WAIT) return;
@@ -311,6 +354,33 @@ TcpCubic::InitializeCwnd (void)
   m_cWnd = m_initialCWnd * m_segmentSize;
 }
 
+/*
+ * Multiplicative decrease on loss: remember the window the loss happened
+ * at (lower, with fast convergence, if it did not grow back since the last
+ * loss), cut cwnd by beta and set ssthresh to it.
+ */
+void
+TcpCubic::CubicReduce (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_epochStart = Time ();
+  uint32_t cWnd = m_cWnd.Get () / m_segmentSize;
+  if (Simulator::Now () > m_wLastTime + 0.1 * m_k)
+    {
+      if (cWnd < m_wLastMax && m_fastConv)
+        {
+          m_wLastMax = cWnd * (2.0 - m_beta) / 2.0;
+        }
+      else
+        {
+          m_wLastMax = cWnd;
+        }
+    }
+  m_wLastTime = Simulator::Now ();
+  m_cWnd = m_cWnd.Get () * (1.0 - m_beta);
+  m_ssThresh = m_cWnd.Get ();
+}
+
 double 
 TcpCubic::CubicUpdate (void)
 {
@@ -330,11 +400,22 @@ TcpCubic::CubicUpdate (void)
 	  NS_LOG_INFO ("Starting new epoch");
 	  if (cWnd < m_wLastMax)
 		{
-		  m_k = pow((m_wLastMax - cWnd) / m_c, (1.0 / 3.0));
+		  if (m_fixedPoint)
+			{
+			  m_cubeRttScale = std::max (1u, static_cast<uint32_t> (m_c * 1024 + 0.5));
+			  m_kFixed = CubicKFixed (m_wLastMax - cWnd, m_cubeRttScale);
+			  m_k = m_kFixed / 1024.0;
+			}
+		  else
+			{
+			  m_k = CubicK (m_wLastMax - cWnd, m_c);
+			}
 		  m_originPoint = m_wLastMax;
 		}
 	  else
 		{
+		  m_cubeRttScale = std::max (1u, static_cast<uint32_t> (m_c * 1024 + 0.5));
+		  m_kFixed = 0u;
 		  m_k = 0.0;
 		  m_originPoint = cWnd;
 		}
@@ -342,23 +423,222 @@ TcpCubic::CubicUpdate (void)
 	  m_wTcp = cWnd;
 	}
 	
-  double t = (Simulator::Now () + m_dMin - m_epochStart).GetSeconds ();
-  double target = m_originPoint + m_c * pow(t - m_k, 3.0);
-  
   double cnt;
-	
-  if (target > cWnd)
+
+  if (m_fixedPoint)
 	{
-	  cnt = cWnd / (target - cWnd);
+	  cnt = CubicFixedPointCnt (cWnd);
 	}
   else
 	{
-	  cnt = 100u * cWnd;
+	  double t = (Simulator::Now () + m_dMin - m_epochStart).GetSeconds ();
+	  double target = CubicTarget (t, m_k, m_c, m_originPoint);
+
+	  if (target > cWnd)
+		{
+		  cnt = cWnd / (target - cWnd);
+		}
+	  else
+		{
+		  cnt = 100u * cWnd;
+		}
 	}
   
   return m_tcpFrndlyness ? CubicTcpFriendliness (cnt) : cnt;
 }
 
+uint32_t
+TcpCubic::CubicFixedPointCnt (uint32_t cWnd)
+{
+  NS_LOG_FUNCTION (this << cWnd);
+
+  int64_t us = (Simulator::Now () + m_dMin - m_epochStart).GetMicroSeconds ();
+  uint64_t t = (static_cast<uint64_t> (std::max (us, static_cast<int64_t> (0))) << 10) / 1000000;
+  uint64_t target = CubicTargetFixed (t, m_kFixed, m_cubeRttScale, m_originPoint);
+
+  if (target > cWnd)
+    {
+      return static_cast<uint32_t> (cWnd / (target - cWnd));
+    }
+  return 100u * cWnd;
+}
+
+double
+TcpCubic::CubicK (uint32_t reduction, double c)
+{
+  return pow (reduction / c, 1.0 / 3.0);
+}
+
+uint32_t
+TcpCubic::CubicKFixed (uint32_t reduction, uint32_t cubeRttScale)
+{
+  // K^3 = reduction / C, in units of 2^-30 s^3 with C scaled by 2^10
+  return CubicRoot ((static_cast<uint64_t> (1) << 40) / cubeRttScale * reduction);
+}
+
+double
+TcpCubic::CubicTarget (double t, double k, double c, uint32_t originPoint)
+{
+  return originPoint + c * pow (t - k, 3.0);
+}
+
+/*
+ * Same computation as CubicTarget, done as in Linux bictcp_update(): time
+ * is counted in units of 2^-10 seconds and C is scaled by 2^10, so that
+ * the cubic term is a 64-bit integer product shifted right by 10 + 3 * 10
+ * bits. Within max (2 segments, 1% of the target) of CubicTarget, see
+ * scratch/cubic-fixed-point-check.cc.
+ */
+uint64_t
+TcpCubic::CubicTargetFixed (uint64_t t, uint32_t kFixed, uint32_t cubeRttScale, uint32_t originPoint)
+{
+  uint64_t offs = (t < kFixed) ? kFixed - t : t - kFixed;
+
+  // Past 2^18 units (256 s) the target is far beyond any cwnd anyway;
+  // clamping keeps offs^3 within 54 bits
+  offs = std::min (offs, static_cast<uint64_t> (1) << 18);
+  uint64_t cube = offs * offs * offs;
+  uint64_t delta;
+  if (cube <= ~static_cast<uint64_t> (0) / cubeRttScale)
+    {
+      delta = (cubeRttScale * cube) >> 40;
+    }
+  else
+    {
+      delta = cubeRttScale * (cube >> 40);
+    }
+
+  if (t < kFixed)
+    {
+      return (originPoint > delta) ? originPoint - delta : 0;
+    }
+  return originPoint + delta;
+}
+
+/*
+ * Integer cube root, from Linux tcp_cubic.c: a 64-entry table gives an
+ * initial estimate from the most significant bits, refined by one
+ * Newton-Raphson step. Average relative error is about 0.2%.
+ */
+uint32_t
+TcpCubic::CubicRoot (uint64_t a)
+{
+  static const uint8_t v[] = {
+    /* 0x00 */    0,   54,   54,   54,  118,  118,  118,  118,
+    /* 0x08 */  123,  129,  134,  138,  143,  147,  151,  156,
+    /* 0x10 */  157,  161,  164,  168,  170,  173,  176,  179,
+    /* 0x18 */  181,  185,  187,  190,  192,  194,  197,  199,
+    /* 0x20 */  200,  202,  204,  206,  209,  211,  213,  215,
+    /* 0x28 */  217,  219,  221,  222,  224,  225,  227,  229,
+    /* 0x30 */  231,  232,  234,  236,  237,  239,  240,  242,
+    /* 0x38 */  244,  245,  246,  248,  250,  251,  252,  254,
+  };
+
+  uint32_t b = 0; // index of the most significant bit, counting from 1
+  for (uint64_t x = a; x != 0; x >>= 1)
+    {
+      b++;
+    }
+  if (b < 7)
+    { // a in [0..63]
+      return (static_cast<uint32_t> (v[a]) + 35) >> 6;
+    }
+
+  b = ((b * 84) >> 8) - 1;
+  uint32_t shift = static_cast<uint32_t> (a >> (b * 3));
+  uint32_t x = (static_cast<uint32_t> (v[shift] + 10) << b) >> 6;
+
+  // x(k+1) = (2 * x(k) + a / x(k)^2) / 3
+  x = 2 * x + static_cast<uint32_t> (a / (static_cast<uint64_t> (x) * (x - 1)));
+  x = (x * 341) >> 10;
+  return x;
+}
+
+/*
+ * HyStart (Ha and Rhee, 2011), as in Linux tcp_cubic.c. Within each round
+ * (one window of data), slow start ends when the ACKs arriving closely
+ * spaced span more than half the minimum RTT, or when the minimum of the
+ * first RTT samples of the round exceeds the minimum RTT by more than
+ * clamp(dMin/8, 4ms, 16ms). ssthresh is then set to cwnd.
+ */
+bool
+TcpCubic::HyStartUpdate (const SequenceNumber32& seq)
+{
+  NS_LOG_FUNCTION (this << seq);
+
+  if (m_hystartFound)
+    {
+      return true;
+    }
+  if (m_cWnd < m_hystartLowWindow * m_segmentSize || m_dMin.IsZero ())
+    {
+      return false;
+    }
+  if (seq > m_roundEnd)
+    {
+      HyStartReset ();
+    }
+
+  Time now = Simulator::Now ();
+  uint32_t reason = SS_EXIT_THRESHOLD;
+
+  // ACK train detection
+  if (now - m_lastAck <= MilliSeconds (2))
+    {
+      m_lastAck = now;
+      if (now - m_roundStart > MicroSeconds (m_dMin.GetMicroSeconds () / 2))
+        {
+          reason = SS_EXIT_ACK_TRAIN;
+        }
+    }
+
+  // Delay increase detection
+  if (reason == SS_EXIT_THRESHOLD)
+    {
+      if (m_sampleCnt < 8)
+        {
+          if (m_currRtt.IsZero () || m_lastRtt.Get () < m_currRtt)
+            {
+              m_currRtt = m_lastRtt.Get ();
+            }
+          m_sampleCnt++;
+        }
+      else
+        {
+          Time eta = MicroSeconds (std::min (std::max (m_dMin.GetMicroSeconds () / 8,
+                                                       static_cast<int64_t> (4000)),
+                                             static_cast<int64_t> (16000)));
+          if (m_currRtt > m_dMin + eta)
+            {
+              reason = SS_EXIT_DELAY;
+            }
+        }
+    }
+
+  if (reason == SS_EXIT_THRESHOLD)
+    {
+      return false;
+    }
+
+  NS_LOG_INFO ("HyStart " << (reason == SS_EXIT_ACK_TRAIN ? "ACK train" : "delay increase")
+               << " detected, leaving slow start at cwnd " << m_cWnd);
+  m_hystartFound = true;
+  m_ssThresh = m_cWnd.Get ();
+  m_slowStartExit (reason, m_cWnd.Get ());
+  return true;
+}
+
+void
+TcpCubic::HyStartReset (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_roundStart = Simulator::Now ();
+  m_lastAck = m_roundStart;
+  m_roundEnd = m_highTxMark.Get ();
+  m_currRtt = Time ();
+  m_sampleCnt = 0u;
+}
+
 double 
 TcpCubic::CubicTcpFriendliness (double cnt)
 {
@@ -397,8 +677,16 @@ TcpCubic::CubicReset (void)
   m_dMin = Time();
   m_wTcp = 0u;
   m_k = 0.0;
+  m_kFixed = 0u;
+  m_cubeRttScale = 1u;
   m_ackCnt = 0u;
   m_wLastTime = Time();
+  m_hystartFound = false;
+  m_roundEnd = SequenceNumber32 (0);
+  m_roundStart = Time ();
+  m_lastAck = Time ();
+  m_currRtt = Time ();
+  m_sampleCnt = 0u;
 }
 
 } // namespace ns3
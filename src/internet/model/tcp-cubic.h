@@ -22,6 +22,7 @@
 #define TCP_CUBIC_H
 
 #include "tcp-socket-base.h"
+#include "ns3/traced-callback.h"
 
 namespace ns3 {
 
@@ -32,11 +33,27 @@ namespace ns3 {
  * \brief An implementation of a stream socket using TCP.
  *
  * This class contains the CUBIC implementation of TCP.
+ *
+ * With the Prr attribute of TcpSocketBase, fast recovery reduces the data
+ * in flight to the window CUBIC ends it with by proportional rate
+ * reduction (RFC 6937) instead of inflating cwnd on every dupack.
  */
 class TcpCubic : public TcpSocketBase
 {
 public:
   static TypeId GetTypeId (void);
+
+  /**
+   * Reason reported by the SlowStartExit trace source
+   */
+  enum SlowStartExit_t
+  {
+    SS_EXIT_THRESHOLD = 0, //!< cwnd grew past ssthresh
+    SS_EXIT_LOSS,          //!< fast retransmit during slow start
+    SS_EXIT_ACK_TRAIN,     //!< HyStart: ACK train longer than half the minimum RTT
+    SS_EXIT_DELAY          //!< HyStart: RTT increased over the minimum RTT
+  };
+
   /**
    * Create an unbound tcp socket.
    */
@@ -48,6 +65,39 @@ public:
   virtual int Connect (const Address &address);
   virtual int Listen (void);
 
+  /**
+   * \brief Time for the window to grow back to w_last_max, floating point
+   * \param reduction w_last_max minus the window at the start of the epoch, in segments
+   * \param c the CUBIC constant
+   * \returns K, in seconds
+   */
+  static double CubicK (uint32_t reduction, double c);
+  /**
+   * \brief Time for the window to grow back to w_last_max, fixed point
+   * \param reduction w_last_max minus the window at the start of the epoch, in segments
+   * \param cubeRttScale the CUBIC constant scaled by 2^10
+   * \returns K, in units of 2^-10 seconds
+   */
+  static uint32_t CubicKFixed (uint32_t reduction, uint32_t cubeRttScale);
+  /**
+   * \brief Window target W(t) = C (t - K)^3 + origin, floating point
+   * \param t time since the start of the epoch, in seconds
+   * \param k K, in seconds
+   * \param c the CUBIC constant
+   * \param originPoint window at the plateau, in segments
+   * \returns the target, in segments
+   */
+  static double CubicTarget (double t, double k, double c, uint32_t originPoint);
+  /**
+   * \brief Window target W(t) = C (t - K)^3 + origin, fixed point
+   * \param t time since the start of the epoch, in units of 2^-10 seconds
+   * \param kFixed K, in units of 2^-10 seconds
+   * \param cubeRttScale the CUBIC constant scaled by 2^10
+   * \param originPoint window at the plateau, in segments
+   * \returns the target, in segments
+   */
+  static uint64_t CubicTargetFixed (uint64_t t, uint32_t kFixed, uint32_t cubeRttScale, uint32_t originPoint);
+
 protected:
   virtual uint32_t Window (void); // Return the max possible number of unacked bytes
   virtual Ptr<TcpSocketBase> Fork (void); // Call CopyObject<TcpCubic> to clone me
@@ -63,9 +113,14 @@ protected:
   virtual uint32_t GetInitialCwnd (void) const;
 private:
   void InitializeCwnd (void);               // set m_cWnd when connection starts
+  void CubicReduce (void);                  // w_last_max and multiplicative decrease on loss
   double CubicUpdate (void);                // update CUBIC parameters
+  uint32_t CubicFixedPointCnt (uint32_t cWnd); // ACKs per cwnd increment, fixed-point arithmetic
+  static uint32_t CubicRoot (uint64_t a);   // integer cube root
   double CubicTcpFriendliness (double cnt); // update CUBIC parameters
   void CubicReset (void);                   // reset CUBIC parameters
+  bool HyStartUpdate (const SequenceNumber32& seq); // true if slow start is to end
+  void HyStartReset (void);                 // start a new HyStart round
 
 protected:
   TracedValue<uint32_t>  m_cWnd;         //!< Congestion window
@@ -79,6 +134,8 @@ protected:
   bool                   m_fastConv;     //!< Fast convergence to lower window size
   double                 m_beta;         //!< BIC-TCP reduction factor
   double                 m_c;            //!< CUBIC constant parameter
+  bool                   m_fixedPoint;   //!< Use fixed-point arithmetic in CubicUpdate
+  uint32_t               m_cubeRttScale; //!< m_c scaled by 2^10
   uint32_t               m_wLastMax;     //!< cWnd value during last packet loss
   Time                   m_wLastTime;    //!< Time since last packet loss
   Time                   m_epochStart;   //!< Time since first ACK was received
@@ -86,8 +143,18 @@ protected:
   Time                   m_dMin;         //!< Minimum RTT during this connection
   uint32_t               m_wTcp;         //!< TCP window size in terms of elapsed time
   double                 m_k;            //!< Time to reach w_last_max value again
+  uint32_t               m_kFixed;       //!< m_k in units of 2^-10 seconds
   uint32_t               m_ackCnt;
   uint32_t               m_cWndCnt;
+  bool                   m_hystart;      //!< Use HyStart to leave slow start
+  uint32_t               m_hystartLowWindow; //!< cwnd, in segments, under which HyStart is off
+  bool                   m_hystartFound; //!< HyStart ended slow start
+  SequenceNumber32       m_roundEnd;     //!< Highest Tx seqnum when the round started
+  Time                   m_roundStart;   //!< Start time of the round
+  Time                   m_lastAck;      //!< Arrival of the last ACK of the train
+  Time                   m_currRtt;      //!< Minimum RTT sampled in the round
+  uint32_t               m_sampleCnt;    //!< Number of RTT samples in the round
+  TracedCallback<uint32_t, uint32_t> m_slowStartExit; //!< Reason and cwnd when leaving slow start
 };
 
 } // namespace ns3
@@ -9,6 +9,7 @@
 #include "tcp-newvegas.h"
 #include "ns3/log.h"
 #include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
 #include "ns3/simulator.h"
 #include "ns3/abort.h"
 #include "ns3/node.h"
@@ -26,6 +27,24 @@ TcpNewVegas::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::TcpNewVegas")
     .SetParent<TcpSocketBase> ()
     .AddConstructor<TcpNewVegas> ()
+    .AddAttribute ("InfoAllocations",
+                   "Number of allocations of the sent segment table storage",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpNewVegas::GetInfoAllocations),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("InfoPeakNodes",
+                   "Largest number of segments held at once in the sent segment table",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpNewVegas::GetInfoPeakNodes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("InfoBytes",
+                   "Bytes allocated for the sent segment table storage",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpNewVegas::GetInfoBytes),
+                   MakeUintegerChecker<uint32_t> ())
     .AddTraceSource ("CongestionWindow",
                      "The TCP connection's congestion window",
                      MakeTraceSourceAccessor (&TcpNewVegas::m_cWnd))
@@ -43,6 +62,7 @@ TcpNewVegas::TcpNewVegas (void)
   m_alpha (2), 
   m_beta (4), 
   m_gamma (1), 
+  m_diff (0),
   m_slowStart(true), 
   m_slowStartBool (true),
   m_checkRetransmit(0)
@@ -98,35 +118,42 @@ TcpNewVegas::Window (void)
   return std::min (m_rWnd.Get (), m_cWnd.Get ());
 }
 
+/* In slow start, pace at (at least) twice the window per RTT, the rate the
+ * ACKs open the window at */
+DataRate
+TcpNewVegas::GetPacingRate (void)
+{
+  return WindowRate (m_slowStart ? std::max (2.0, m_pacingGain) : m_pacingGain);
+}
+
 Ptr<TcpSocketBase>
 TcpNewVegas::Fork (void)
 {
   return CopyObject<TcpNewVegas> (this);
 }
 
-uint32_t
-TcpNewVegas::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck) {
-
-  uint32_t size = TcpSocketBase::SendDataPacket(seq, maxSize, withAck);
-
-  NS_LOG_LOGIC ("Seq: " << seq + size);
-
-  m_info.Add(seq + size); // Create new node and add it to the list
-  m_info.AddBytes(size); // Update sent bytes
-  return size;
-}
-
 void
 TcpNewVegas::EstimateDiff (SequenceNumber32 const& seq)
 {
-  VegasNode node = m_info.GetFirstNode(seq); // Get node with info
+  uint32_t i = m_sentTable.Find(seq); // Get segment acknowledged
+  bool found = i < m_sentTable.Size ();
+  if (!found && !m_timestampPermitted)
+    {
+      NS_LOG_LOGIC ("No segment ends at " << seq << ", keeping Diff " << m_diff);
+      return;
+    }
 
-  Time rtt = Simulator::Now() - node.GetSentTime(); // Calculate RTT
+  // With timestamps, the RTT of this very ACK was measured in EstimateRtt
+  Time rtt = m_timestampPermitted ? m_lastRtt.Get () : Simulator::Now() - m_sentTable.GetFirstSentTime(i); // Calculate RTT
   int64_t lastRTT = rtt.GetInteger ();
+  if (lastRTT <= 0)
+    {
+      return;
+    }
 
-  uint32_t bytes = node.GetBytes(); // Get bytes sent in last RTT
+  uint32_t bytes = found ? m_sentTable.GetBytesSent() - m_sentTable.GetBytesSentSnapshot(i) : 0; // Get bytes sent in last RTT
 
-  if (bytes <= m_segmentSize) { // If only sent one packet in last RTT, reset BaseRTT
+  if (found && bytes <= m_segmentSize) { // If only sent one packet in last RTT, reset BaseRTT
     m_baseRTT =  lastRTT;
     NS_LOG_INFO ("Reset BaseRTT to: " << m_baseRTT);
   }
@@ -192,13 +219,32 @@ TcpNewVegas::NewAck (const SequenceNumber32& seq)
   else
     CongestionAvoidance();
 
+  // Remember when the acked segment was last sent, TcpSocketBase::NewAck
+  // drops it from the sent segment table
+  uint32_t i = m_sentTable.Find(seq);
+  Time lastSent = (i < m_sentTable.Size ()) ? m_sentTable.GetSentTime(i) : Time ();
+
+  if (m_inFastRec && !m_sackRecovery && m_prrActive)
+    { // PRR brought the data in flight down to 3/4 cwnd: end the recovery
+      // before sending on this ACK
+      PrrStop ();
+      m_cWnd = m_cWnd * 3 / 4;
+      m_inFastRec = false;
+      NS_LOG_INFO ("Reset cwnd to " << m_cWnd);
+    }
+
   // Complete newAck processing
   TcpSocketBase::NewAck (seq);
 
-  // Check for exit condition of fast recovery
-  if (m_inFastRec)
-    { // First new ACK after fast recovery: update cwnd to 3/4*cwnd
-      m_cWnd = m_cWnd * 3 / 4; 
+  // Check for exit condition of fast recovery, with SACK the whole
+  // recovery is acknowledged first
+  if (m_inFastRec && !m_sackRecovery)
+    { // First new ACK after fast recovery: update cwnd to 3/4*cwnd, unless
+      // SACK recovery already reduced it when it started
+      if (!m_sackPermitted)
+        {
+          m_cWnd = m_cWnd * 3 / 4;
+        }
       m_inFastRec = false;
       NS_LOG_INFO ("Reset cwnd to " << m_cWnd);
     }
@@ -206,8 +252,7 @@ TcpNewVegas::NewAck (const SequenceNumber32& seq)
   // Check for retransmit if first/second ACK after DupAck
   if (m_checkRetransmit){
     NS_LOG_LOGIC ("Check for retransmit (" << m_checkRetransmit << ")");
-    VegasNode node = m_info.GetLastNode(seq); // Get node with info
-    Time rtt = Simulator::Now() - node.GetSentTime(); // Calculate RTT for the specific packet
+    Time rtt = Simulator::Now() - lastSent; // Calculate RTT for the specific packet
 
     if (m_rto.Get() < rtt) // If RTT>RTO, retransmits
     {
@@ -219,8 +264,6 @@ TcpNewVegas::NewAck (const SequenceNumber32& seq)
     else
       m_checkRetransmit--;
   }
-  
-  m_info.DiscardUpTo(seq); //Delete old info
 }
 
 // Fast recovery and fast retransmit, extends TcpReno::DupAck
@@ -230,22 +273,38 @@ TcpNewVegas::DupAck (const TcpHeader& t, uint32_t count)
   NS_LOG_FUNCTION (this << "t " << count);
   if (!m_inFastRec)
     { // Check to fast retransmit
-      VegasNode node = m_info.GetLastNode(t.GetAckNumber()); // Get node with info
-      Time rtt = Simulator::Now() - node.GetSentTime(); // Calculate RTT for the specific packet
+      uint32_t i = m_sentTable.Find(t.GetAckNumber()); // Get segment with info
+      Time lastSent = (i < m_sentTable.Size ()) ? m_sentTable.GetSentTime(i) : Time ();
+      Time rtt = Simulator::Now() - lastSent; // Calculate RTT for the specific packet
       if (m_rto.Get() < rtt) // If RTT>RTO, retransmits
       {
         m_ssThresh = std::max (2 * m_segmentSize, BytesInFlight () / 2);
-        m_cWnd = m_ssThresh + 3 * m_segmentSize;
+        if (m_prr)
+          { // Bring the data in flight down to the window the recovery ends with
+            PrrStart (std::max (2 * m_segmentSize, m_cWnd.Get () * 3 / 4));
+          }
+        else if (m_sackPermitted)
+          { // cwnd = ssthresh (RFC 6675, sec.5 step 4.2); the pipe estimate
+            // accounts for the segments that left
+            m_cWnd = m_ssThresh;
+          }
+        else
+          {
+            m_cWnd = m_ssThresh + 3 * m_segmentSize;
+          }
         m_inFastRec = true;
         m_checkRetransmit = 2; // Flag to check the next 2 ACKs
         NS_LOG_INFO ("Retransmit. Reset cwnd to " << m_cWnd << ", ssthresh to " << m_ssThresh);
-        DoRetransmit ();
+        FastRetransmit ();
       }
     }
   else if (m_inFastRec)
     { // In fast recovery, inc cwnd for every additional dupack (RFC2581, sec.3.2)
-      m_cWnd += m_segmentSize;
-      NS_LOG_INFO ("In fast recovery, increased cwnd to " << m_cWnd);
+      if (!m_sackRecovery && !m_prrActive)
+        {
+          m_cWnd += m_segmentSize;
+          NS_LOG_INFO ("In fast recovery, increased cwnd to " << m_cWnd);
+        }
       SendPendingData (m_connected);
     };
 }
@@ -256,6 +315,7 @@ void TcpNewVegas::Retransmit (void)
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC (this << " ReTxTimeout Expired at time " << Simulator::Now ().GetSeconds ());
   m_inFastRec = false;
+  PrrStop ();
 
   // If erroneous timeout in closed/timed-wait state, just return
   if (m_state == CLOSED || m_state == TIME_WAIT) return;
@@ -307,6 +367,24 @@ TcpNewVegas::GetInitialCwnd (void) const
   return m_initialCWnd;
 }
 
+uint32_t
+TcpNewVegas::GetInfoAllocations (void) const
+{
+  return m_sentTable.GetAllocations ();
+}
+
+uint32_t
+TcpNewVegas::GetInfoPeakNodes (void) const
+{
+  return m_sentTable.GetPeakSegments ();
+}
+
+uint32_t
+TcpNewVegas::GetInfoBytes (void) const
+{
+  return m_sentTable.GetAllocatedBytes ();
+}
+
 void 
 TcpNewVegas::InitializeCwnd (void)
 {
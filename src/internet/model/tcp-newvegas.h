@@ -7,7 +7,6 @@
 #define TCP_NEWVEGAS_H
 
 #include "tcp-socket-base.h"
-#include "vegas-list.h"
 
 namespace ns3 {
 
@@ -41,9 +40,8 @@ public:
   virtual int Listen (void); // Initializes m_cWnd
 
 protected:
-  virtual uint32_t SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck);
-
   virtual uint32_t Window (void); // Return the max possible number of unacked bytes
+  virtual DataRate GetPacingRate (void); // Twice the window per RTT in slow start
   virtual Ptr<TcpSocketBase> Fork (void); // Call CopyObject<TcpNewVegas> to clone me
   virtual void NewAck (const SequenceNumber32& seq); // Inc cwnd and call NewAck() of parent
   virtual void DupAck (const TcpHeader& t, uint32_t count);  // Fast retransmit
@@ -64,6 +62,9 @@ private:
   void CongestionAvoidance (void);
   void EstimateDiff (const SequenceNumber32& seq);
   void BaseRTTChange (int64_t o , int64_t n);
+  uint32_t GetInfoAllocations (void) const; // Allocations of m_sentTable storage
+  uint32_t GetInfoPeakNodes (void) const;   // Peak number of segments in m_sentTable
+  uint32_t GetInfoBytes (void) const;       // Bytes allocated by m_sentTable
 
 protected:
   TracedValue<uint32_t>  m_cWnd;         //!< Congestion window
@@ -79,7 +80,6 @@ protected:
   bool                   m_slowStart;    //< True if slowstart. False if congestion avidance.
   bool                   m_slowStartBool;
 
-  VegasList              m_info;
   uint32_t               m_checkRetransmit;
 
 };
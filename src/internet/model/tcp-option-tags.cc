@@ -0,0 +1,242 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tcp-option-tags.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE ("TcpOptionTags");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (TcpSackTag)
+  ;
+
+TcpSackTag::TcpSackTag ()
+  : m_nBlocks (0)
+{
+}
+
+bool
+TcpSackTag::AddBlock (const SackBlock& block)
+{
+  if (m_nBlocks == MAX_BLOCKS)
+    {
+      return false;
+    }
+  m_blocks[m_nBlocks++] = block;
+  return true;
+}
+
+uint8_t
+TcpSackTag::GetNBlocks (void) const
+{
+  return m_nBlocks;
+}
+
+TcpSackTag::SackBlock
+TcpSackTag::GetBlock (uint8_t i) const
+{
+  NS_ASSERT (i < m_nBlocks);
+  return m_blocks[i];
+}
+
+TypeId
+TcpSackTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpSackTag")
+    .SetParent<Tag> ()
+    .AddConstructor<TcpSackTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpSackTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+TcpSackTag::GetSerializedSize (void) const
+{
+  return 1 + 8 * m_nBlocks;
+}
+
+void
+TcpSackTag::Serialize (TagBuffer i) const
+{
+  i.WriteU8 (m_nBlocks);
+  for (uint8_t j = 0; j < m_nBlocks; ++j)
+    {
+      i.WriteU32 (m_blocks[j].first.GetValue ());
+      i.WriteU32 (m_blocks[j].second.GetValue ());
+    }
+}
+
+void
+TcpSackTag::Deserialize (TagBuffer i)
+{
+  uint8_t n = i.ReadU8 ();
+  m_nBlocks = (n < MAX_BLOCKS) ? n : MAX_BLOCKS;
+  for (uint8_t j = 0; j < m_nBlocks; ++j)
+    {
+      m_blocks[j].first = SequenceNumber32 (i.ReadU32 ());
+      m_blocks[j].second = SequenceNumber32 (i.ReadU32 ());
+    }
+}
+
+void
+TcpSackTag::Print (std::ostream &os) const
+{
+  os << "SACK";
+  for (uint8_t j = 0; j < m_nBlocks; ++j)
+    {
+      os << " [" << m_blocks[j].first << ":" << m_blocks[j].second << ")";
+    }
+}
+
+NS_OBJECT_ENSURE_REGISTERED (TcpWindowScaleTag)
+  ;
+
+TcpWindowScaleTag::TcpWindowScaleTag ()
+  : m_scale (0)
+{
+}
+
+void
+TcpWindowScaleTag::SetScale (uint8_t scale)
+{
+  NS_ASSERT (scale <= 14);
+  m_scale = scale;
+}
+
+uint8_t
+TcpWindowScaleTag::GetScale (void) const
+{
+  return m_scale;
+}
+
+TypeId
+TcpWindowScaleTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpWindowScaleTag")
+    .SetParent<Tag> ()
+    .AddConstructor<TcpWindowScaleTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpWindowScaleTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+TcpWindowScaleTag::GetSerializedSize (void) const
+{
+  return 1;
+}
+
+void
+TcpWindowScaleTag::Serialize (TagBuffer i) const
+{
+  i.WriteU8 (m_scale);
+}
+
+void
+TcpWindowScaleTag::Deserialize (TagBuffer i)
+{
+  m_scale = i.ReadU8 ();
+}
+
+void
+TcpWindowScaleTag::Print (std::ostream &os) const
+{
+  os << "WS " << static_cast<uint32_t> (m_scale);
+}
+
+NS_OBJECT_ENSURE_REGISTERED (TcpTimestampTag)
+  ;
+
+TcpTimestampTag::TcpTimestampTag ()
+  : m_tsval (0),
+    m_tsecr (0)
+{
+}
+
+void
+TcpTimestampTag::SetTimestamps (uint32_t tsval, uint32_t tsecr)
+{
+  m_tsval = tsval;
+  m_tsecr = tsecr;
+}
+
+uint32_t
+TcpTimestampTag::GetTsval (void) const
+{
+  return m_tsval;
+}
+
+uint32_t
+TcpTimestampTag::GetTsecr (void) const
+{
+  return m_tsecr;
+}
+
+TypeId
+TcpTimestampTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpTimestampTag")
+    .SetParent<Tag> ()
+    .AddConstructor<TcpTimestampTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpTimestampTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+TcpTimestampTag::GetSerializedSize (void) const
+{
+  return 8;
+}
+
+void
+TcpTimestampTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_tsval);
+  i.WriteU32 (m_tsecr);
+}
+
+void
+TcpTimestampTag::Deserialize (TagBuffer i)
+{
+  m_tsval = i.ReadU32 ();
+  m_tsecr = i.ReadU32 ();
+}
+
+void
+TcpTimestampTag::Print (std::ostream &os) const
+{
+  os << "TS val " << m_tsval << " ecr " << m_tsecr;
+}
+
+} // namespace ns3
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef TCP_OPTION_TAGS_H
+#define TCP_OPTION_TAGS_H
+
+#include <stdint.h>
+#include <utility>
+#include "ns3/tag.h"
+#include "ns3/sequence-number.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * TcpHeader does not serialize TCP options. TcpSocketBase::AddOptions ()
+ * and TcpSocketBase::ReadOptions () carry them as packet tags on the
+ * segment instead; the tags below hold one option kind each.
+ */
+
+/**
+ * \ingroup tcp
+ * \brief SACK option (RFC 2018)
+ *
+ * On a SYN or SYN+ACK, the presence of the tag stands for the
+ * SACK-permitted option. On other segments it carries up to MAX_BLOCKS
+ * blocks of out-of-order data held by the receiver, the most recently
+ * received first. Packet tags are limited in size, hence fewer blocks
+ * than the three or four a real header would fit.
+ */
+class TcpSackTag : public Tag
+{
+public:
+  typedef std::pair<SequenceNumber32, SequenceNumber32> SackBlock; //!< [left edge, right edge)
+
+  static const uint8_t MAX_BLOCKS = 2; //!< Blocks that fit in a tag
+
+  TcpSackTag ();
+
+  /**
+   * \brief Append a block, if there is room left
+   * \param block the block
+   * \returns true if the block was added
+   */
+  bool AddBlock (const SackBlock& block);
+  /**
+   * \brief Number of blocks carried
+   * \returns the number of blocks
+   */
+  uint8_t GetNBlocks (void) const;
+  /**
+   * \brief Get a block
+   * \param i index of the block, less than GetNBlocks ()
+   * \returns the block
+   */
+  SackBlock GetBlock (uint8_t i) const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint8_t m_nBlocks;                //!< Number of valid blocks
+  SackBlock m_blocks[MAX_BLOCKS];   //!< The blocks
+};
+
+/**
+ * \ingroup tcp
+ * \brief Window scale option (RFC 7323), only on SYN and SYN+ACK
+ */
+class TcpWindowScaleTag : public Tag
+{
+public:
+  TcpWindowScaleTag ();
+
+  /**
+   * \brief Set the shift count
+   * \param scale the shift count, at most 14
+   */
+  void SetScale (uint8_t scale);
+  /**
+   * \brief Get the shift count
+   * \returns the shift count
+   */
+  uint8_t GetScale (void) const;
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint8_t m_scale; //!< Shift count
+};
+
+/**
+ * \ingroup tcp
+ * \brief Timestamps option (RFC 7323)
+ *
+ * TSval is taken from a microsecond clock; TSecr echoes the TSval most
+ * recently received from the peer, or is zero on a SYN.
+ */
+class TcpTimestampTag : public Tag
+{
+public:
+  TcpTimestampTag ();
+
+  /**
+   * \brief Set the timestamp value and echo reply
+   * \param tsval the sender's timestamp
+   * \param tsecr the echoed timestamp
+   */
+  void SetTimestamps (uint32_t tsval, uint32_t tsecr);
+  uint32_t GetTsval (void) const; //!< Sender's timestamp
+  uint32_t GetTsecr (void) const; //!< Echoed timestamp
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint32_t m_tsval; //!< Timestamp value
+  uint32_t m_tsecr; //!< Timestamp echo reply
+};
+
+} // namespace ns3
+
+#endif /* TCP_OPTION_TAGS_H */
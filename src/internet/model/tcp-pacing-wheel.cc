@@ -0,0 +1,284 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tcp-pacing-wheel.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("TcpPacingWheel");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (TcpPacingWheel);
+
+TcpPacingWheel::Timer::Timer (uint64_t tick, const Callback<void> &callback)
+  : m_tick (tick),
+    m_callback (callback),
+    m_pending (true)
+{
+}
+
+void
+TcpPacingWheel::Timer::Cancel (void)
+{
+  m_pending = false;
+  m_callback = MakeNullCallback<void> ();
+}
+
+bool
+TcpPacingWheel::Timer::IsPending (void) const
+{
+  return m_pending;
+}
+
+TypeId
+TcpPacingWheel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpPacingWheel")
+    .SetParent<Object> ()
+    .AddConstructor<TcpPacingWheel> ()
+    .AddAttribute ("Granularity", "Duration of a tick of the wheel. Timers fire at the end "
+                   "of the tick holding their time. Only set before the first timer is armed.",
+                   TimeValue (MicroSeconds (1)),
+                   MakeTimeAccessor (&TcpPacingWheel::m_granularity),
+                   MakeTimeChecker ())
+    .AddAttribute ("Timers",
+                   "Number of timers held, including cancelled ones",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpPacingWheel::GetNTimers),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Fired",
+                   "Number of timers fired",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpPacingWheel::GetNFired),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("Events",
+                   "Number of simulator events scheduled to run the wheel",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpPacingWheel::GetNEvents),
+                   MakeUintegerChecker<uint64_t> ())
+  ;
+  return tid;
+}
+
+TcpPacingWheel::TcpPacingWheel (void)
+  : m_granularity (MicroSeconds (1)),
+    m_tick (0),
+    m_size (0),
+    m_eventTick (0),
+    m_fired (0),
+    m_events (0)
+{
+  NS_LOG_FUNCTION (this);
+  for (uint32_t l = 0; l < LEVELS; ++l)
+    {
+      m_count[l] = 0;
+    }
+}
+
+TcpPacingWheel::~TcpPacingWheel (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TcpPacingWheel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  for (uint32_t l = 0; l < LEVELS; ++l)
+    {
+      for (uint32_t i = 0; i < SLOTS; ++i)
+        {
+          m_slots[l][i].clear ();
+        }
+      m_count[l] = 0;
+    }
+  m_size = 0;
+  Object::DoDispose ();
+}
+
+Ptr<TcpPacingWheel>
+TcpPacingWheel::GetWheel (Ptr<Node> node)
+{
+  Ptr<TcpPacingWheel> wheel = node->GetObject<TcpPacingWheel> ();
+  if (wheel == 0)
+    {
+      wheel = CreateObject<TcpPacingWheel> ();
+      node->AggregateObject (wheel);
+    }
+  return wheel;
+}
+
+Ptr<TcpPacingWheel::Timer>
+TcpPacingWheel::Schedule (Time at, const Callback<void> &callback)
+{
+  NS_LOG_FUNCTION (this << at);
+  uint64_t step = m_granularity.GetTimeStep ();
+  if (m_size == 0)
+    { // Nothing to move down: the wheel can jump to the present
+      m_tick = std::max (m_tick, static_cast<uint64_t> (Simulator::Now ().GetTimeStep ()) / step);
+    }
+  uint64_t tick = (static_cast<uint64_t> (at.GetTimeStep ()) + step - 1) / step;
+  Ptr<Timer> timer = Ptr<Timer> (new Timer (std::max (tick, m_tick + 1), callback), false);
+  Insert (timer);
+  if (!m_event.IsRunning () || timer->m_tick < m_eventTick)
+    {
+      Reschedule ();
+    }
+  return timer;
+}
+
+void
+TcpPacingWheel::Insert (Ptr<Timer> timer)
+{
+  NS_ASSERT (timer->m_tick > m_tick);
+  // Lowest level whose slots span the bits in which the tick differs from m_tick
+  uint32_t l = 0;
+  while (l < LEVELS - 1 && (timer->m_tick >> (BITS * (l + 1))) != (m_tick >> (BITS * (l + 1))))
+    {
+      ++l;
+    }
+  NS_ASSERT_MSG ((timer->m_tick >> (BITS * LEVELS)) == (m_tick >> (BITS * LEVELS)),
+                 "Timer beyond the span of the wheel");
+  m_slots[l][(timer->m_tick >> (BITS * l)) & (SLOTS - 1)].push_back (timer);
+  m_count[l]++;
+  m_size++;
+}
+
+uint64_t
+TcpPacingWheel::NextTick (void) const
+{
+  // Slots of a level following the one of m_tick, in the current lap of the
+  // level above: a level's are all before those of the levels above
+  for (uint32_t l = 0; l < LEVELS; ++l)
+    {
+      if (m_count[l] == 0)
+        {
+          continue;
+        }
+      uint32_t shift = BITS * l;
+      for (uint32_t i = ((m_tick >> shift) & (SLOTS - 1)) + 1; i < SLOTS; ++i)
+        {
+          if (!m_slots[l][i].empty ())
+            {
+              return ((m_tick >> (shift + BITS)) << (shift + BITS)) | (static_cast<uint64_t> (i) << shift);
+            }
+        }
+    }
+  NS_ASSERT_MSG (false, "No slot holds the " << m_size << " timers");
+  return m_tick;
+}
+
+void
+TcpPacingWheel::Reschedule (void)
+{
+  m_event.Cancel ();
+  if (m_size == 0)
+    {
+      return;
+    }
+  m_eventTick = NextTick ();
+  Time delay = TimeStep (m_eventTick * m_granularity.GetTimeStep ()) - Simulator::Now ();
+  m_event = Simulator::Schedule (std::max (delay, Time (0)), &TcpPacingWheel::Expire, this);
+  m_events++;
+  NS_LOG_LOGIC ("Wheel runs at tick " << m_eventTick << ", " << m_size << " timers held");
+}
+
+void
+TcpPacingWheel::Expire (void)
+{
+  NS_LOG_FUNCTION (this << m_eventTick);
+  uint64_t last = m_tick;
+  m_tick = m_eventTick;
+  std::vector<Ptr<Timer> > due;
+  // Entering the slot of a higher level: move its timers down
+  for (uint32_t l = LEVELS - 1; l > 0; --l)
+    {
+      if ((m_tick >> (BITS * l)) == (last >> (BITS * l)))
+        {
+          continue;
+        }
+      std::vector<Ptr<Timer> > moved;
+      moved.swap (m_slots[l][(m_tick >> (BITS * l)) & (SLOTS - 1)]);
+      m_count[l] -= moved.size ();
+      m_size -= moved.size ();
+      for (std::vector<Ptr<Timer> >::iterator i = moved.begin (); i != moved.end (); ++i)
+        {
+          if (!(*i)->m_pending)
+            {
+              continue;
+            }
+          if ((*i)->m_tick == m_tick)
+            {
+              due.push_back (*i);
+            }
+          else
+            {
+              Insert (*i);
+            }
+        }
+    }
+  std::vector<Ptr<Timer> > &slot = m_slots[0][m_tick & (SLOTS - 1)];
+  m_count[0] -= slot.size ();
+  m_size -= slot.size ();
+  due.insert (due.end (), slot.begin (), slot.end ());
+  slot.clear ();
+
+  // Callbacks may arm new timers, all due after m_tick
+  for (std::vector<Ptr<Timer> >::iterator i = due.begin (); i != due.end (); ++i)
+    {
+      if ((*i)->m_pending)
+        {
+          Callback<void> callback = (*i)->m_callback;
+          (*i)->Cancel ();
+          m_fired++;
+          callback ();
+        }
+    }
+  if (!m_event.IsRunning ())
+    {
+      Reschedule ();
+    }
+}
+
+uint32_t
+TcpPacingWheel::GetNTimers (void) const
+{
+  return m_size;
+}
+
+uint64_t
+TcpPacingWheel::GetNFired (void) const
+{
+  return m_fired;
+}
+
+uint64_t
+TcpPacingWheel::GetNEvents (void) const
+{
+  return m_events;
+}
+
+} // namespace ns3
@@ -0,0 +1,132 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef TCP_PACING_WHEEL_H
+#define TCP_PACING_WHEEL_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+
+namespace ns3 {
+
+class Node;
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Hierarchical timer wheel releasing the paced segments of the sockets of a node
+ *
+ * Pacing sockets arm a timer on the wheel of their node, aggregated to
+ * the Node on first use, instead of scheduling a simulator event per
+ * segment. Times are rounded up to the Granularity (one tick).
+ *
+ * The wheel has LEVELS levels of SLOTS slots. Level 0 holds the timers
+ * of the current 256 ticks, one slot per tick; level l holds those
+ * whose tick only shares the bits above 8 (l + 1) with the wheel's
+ * tick, one slot per 256^l ticks. Arming a timer is O(1). When the
+ * wheel reaches the slot of a level above 0, the timers of that slot
+ * are moved down to their slot of a lower level.
+ *
+ * The wheel keeps at most one simulator event pending, at the first
+ * tick holding timers or at the start of the first non-empty slot of a
+ * higher level. All the timers of a tick fire from the same event.
+ */
+class TcpPacingWheel : public Object
+{
+public:
+  /**
+   * \brief A timer of the wheel; its owner cancels it before going away
+   */
+  class Timer : public SimpleRefCount<Timer>
+  {
+  public:
+    /**
+     * \brief Cancel the timer; the wheel drops it when reaching its tick
+     */
+    void Cancel (void);
+    /**
+     * \returns true if the timer has neither fired nor been cancelled
+     */
+    bool IsPending (void) const;
+
+  private:
+    friend class TcpPacingWheel;
+    Timer (uint64_t tick, const Callback<void> &callback);
+
+    uint64_t m_tick;            //!< tick the timer fires at
+    Callback<void> m_callback;  //!< function called when the timer fires
+    bool m_pending;             //!< not fired nor cancelled yet
+  };
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpPacingWheel (void);
+  virtual ~TcpPacingWheel (void);
+
+  /**
+   * \brief Get the wheel of a node, aggregating one to the node if needed
+   * \param node the node
+   * \returns the wheel of the node
+   */
+  static Ptr<TcpPacingWheel> GetWheel (Ptr<Node> node);
+
+  /**
+   * \brief Arm a timer
+   * \param at absolute time of expiry, rounded up to the next tick
+   * \param callback function to call then
+   * \returns the timer, for its owner to cancel it
+   */
+  Ptr<Timer> Schedule (Time at, const Callback<void> &callback);
+
+  uint32_t GetNTimers (void) const;     //!< Number of timers held, including cancelled ones
+  uint64_t GetNFired (void) const;      //!< Number of timers fired
+  uint64_t GetNEvents (void) const;     //!< Number of simulator events scheduled
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  static const uint32_t LEVELS = 6;   //!< Number of levels, i.e. 48 bits of ticks
+  static const uint32_t BITS = 8;     //!< Bits of the tick per level
+  static const uint32_t SLOTS = 256;  //!< Slots per level (2 ^ BITS)
+
+  void Insert (Ptr<Timer> timer);     //!< Put a timer due after m_tick in its slot
+  uint64_t NextTick (void) const;     //!< First tick the wheel has to be run at
+  void Reschedule (void);             //!< (Re)schedule m_event for NextTick ()
+  void Expire (void);                 //!< Move the wheel to m_eventTick and fire its timers
+
+  Time m_granularity;                             //!< Duration of a tick
+  uint64_t m_tick;                                //!< Tick the wheel was last run at
+  std::vector<Ptr<Timer> > m_slots[LEVELS][SLOTS]; //!< Timers, by level and slot
+  uint32_t m_count[LEVELS];                       //!< Number of timers per level
+  uint32_t m_size;                                //!< Number of timers held
+  EventId m_event;                                //!< Simulator event running the wheel
+  uint64_t m_eventTick;                           //!< Tick m_event runs the wheel at
+  uint64_t m_fired;                               //!< Timers fired
+  uint64_t m_events;                              //!< Simulator events scheduled
+};
+
+} // namespace ns3
+
+#endif /* TCP_PACING_WHEEL_H */
@@ -0,0 +1,563 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tcp-sent-segment-table.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("TcpSentSegmentTable");
+
+namespace ns3 {
+
+TcpRateSample::TcpRateSample (void)
+  : delivered (0),
+    priorDelivered (0),
+    interval (Time ()),
+    appLimited (false)
+{
+}
+
+TcpSentSegmentTable::TcpSentSegmentTable (void)
+  : m_head (0),
+    m_size (0),
+    m_capacity (0),
+    m_bytesSent (0),
+    m_delivered (0),
+    m_appLimited (0),
+    m_sackedBytes (0),
+    m_heldBytes (0),
+    m_pipeValid (false),
+    m_lostThreshold (0),
+    m_lostEnd (0),
+    m_lostBytes (0),
+    m_lostSacked (0),
+    m_rxtEnd (0),
+    m_rxtBytes (0),
+    m_allocations (0),
+    m_peakSize (0)
+{
+}
+
+void
+TcpSentSegmentTable::Sent (SequenceNumber32 seq, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << seq << size);
+  SequenceNumber32 end = seq + SequenceNumber32 (size);
+  bool retx = false;
+
+  if (m_size == 0)
+    { // Nothing in flight: a new send interval starts
+      m_intervalStart = Simulator::Now ();
+      m_deliveredTime = m_intervalStart;
+    }
+  if (m_size > 0 && seq < m_endSeq[Index (m_size - 1)])
+    { // Retransmission: resend the entries it covers, split at its edges
+      NS_LOG_LOGIC ("Retransmission of [" << seq << ":" << end << ")");
+      retx = true;
+      Split (seq);
+      Split (end);
+      for (uint32_t i = LowerBound (seq + SequenceNumber32 (1));
+           i < m_size && m_startSeq[Index (i)] < end; ++i)
+        {
+          uint32_t k = Index (i);
+          if (!m_retx[k] && !m_sacked[k] && i < m_rxtEnd)
+            {
+              m_rxtBytes += m_endSeq[k] - m_startSeq[k];
+            }
+          m_retx[k] = 1; // Karn's algorithm
+          m_sentTime[k] = Simulator::Now ();
+          m_deliveredSnapshot[k] = m_delivered;
+          m_deliveredTimeSnapshot[k] = m_deliveredTime;
+          m_intervalStartSnapshot[k] = m_intervalStart;
+          m_appLimitedSnapshot[k] = m_appLimited != 0;
+        }
+      SequenceNumber32 last = m_endSeq[Index (m_size - 1)];
+      if (end <= last)
+        {
+          m_bytesSent += size;
+          return;
+        }
+      // Also carries new data: that part gets its own entry
+      m_bytesSent += last - seq;
+      seq = last;
+      size = end - last;
+    }
+
+  if (m_size == m_capacity)
+    {
+      Grow ();
+    }
+  uint32_t k = Index (m_size);
+  m_startSeq[k] = seq;
+  m_endSeq[k] = end;
+  m_firstSentTime[k] = Simulator::Now ();
+  m_sentTime[k] = m_firstSentTime[k];
+  m_bytesSentSnapshot[k] = m_bytesSent;
+  m_deliveredSnapshot[k] = m_delivered;
+  m_deliveredTimeSnapshot[k] = m_deliveredTime;
+  m_intervalStartSnapshot[k] = m_intervalStart;
+  m_appLimitedSnapshot[k] = m_appLimited != 0;
+  m_retx[k] = retx ? 1 : 0;
+  m_sacked[k] = 0;
+  m_size++;
+  m_peakSize = std::max (m_peakSize, m_size);
+  m_bytesSent += size;
+  m_heldBytes += size;
+}
+
+TcpRateSample
+TcpSentSegmentTable::Delivered (SequenceNumber32 ack, uint32_t bytes)
+{
+  NS_LOG_FUNCTION (this << ack << bytes);
+  TcpRateSample rs;
+  m_delivered += bytes;
+  m_deliveredTime = Simulator::Now ();
+  if (m_appLimited != 0 && static_cast<int32_t> (m_delivered - m_appLimited) > 0)
+    {
+      m_appLimited = 0;
+    }
+
+  // Retransmissions aside, the last segment acknowledged is the one sent last
+  uint32_t last = m_size;
+  for (uint32_t i = 0; i < m_size && m_endSeq[Index (i)] <= ack; ++i)
+    {
+      if (last == m_size || m_sentTime[Index (i)] >= m_sentTime[Index (last)])
+        {
+          last = i;
+        }
+    }
+  if (last == m_size)
+    {
+      return rs;
+    }
+  uint32_t k = Index (last);
+  rs.delivered = m_delivered - m_deliveredSnapshot[k];
+  rs.priorDelivered = m_deliveredSnapshot[k];
+  rs.appLimited = m_appLimitedSnapshot[k] != 0;
+  // The send interval guards against ACK compression, the ACK interval
+  // against sending faster than the bottleneck
+  rs.interval = std::max (m_sentTime[k] - m_intervalStartSnapshot[k],
+                          m_deliveredTime - m_deliveredTimeSnapshot[k]);
+  m_intervalStart = m_sentTime[k];
+  return rs;
+}
+
+void
+TcpSentSegmentTable::AppLimited (uint32_t inFlight)
+{
+  m_appLimited = (m_delivered + inFlight != 0) ? m_delivered + inFlight : 1;
+}
+
+void
+TcpSentSegmentTable::DiscardUpTo (SequenceNumber32 ack)
+{
+  NS_LOG_FUNCTION (this << ack);
+  while (m_size > 0 && m_endSeq[m_head] <= ack)
+    {
+      Forget (m_endSeq[m_head] - m_startSeq[m_head]);
+      m_head = Index (1);
+      m_size--;
+      m_lostEnd -= (m_lostEnd > 0) ? 1 : 0;
+      m_rxtEnd -= (m_rxtEnd > 0) ? 1 : 0;
+    }
+  if (m_size == 0)
+    {
+      m_head = 0;
+    }
+  else if (m_startSeq[m_head] < ack)
+    { // Partially acknowledged segment: only the remainder is outstanding
+      Forget (ack - m_startSeq[m_head]);
+      m_startSeq[m_head] = ack;
+    }
+}
+
+void
+TcpSentSegmentTable::Forget (uint32_t bytes)
+{
+  m_heldBytes -= bytes;
+  if (m_sacked[m_head])
+    {
+      m_sackedBytes -= bytes;
+    }
+  if (m_lostEnd > 0)
+    {
+      if (m_sacked[m_head])
+        {
+          m_lostSacked -= bytes;
+        }
+      else
+        {
+          m_lostBytes -= bytes;
+        }
+    }
+  if (m_rxtEnd > 0 && m_retx[m_head] && !m_sacked[m_head])
+    {
+      m_rxtBytes -= bytes;
+    }
+}
+
+uint32_t
+TcpSentSegmentTable::MarkSacked (SequenceNumber32 start, SequenceNumber32 end)
+{
+  NS_LOG_FUNCTION (this << start << end);
+  uint32_t bytes = 0;
+  for (uint32_t i = LowerBound (start + SequenceNumber32 (1));
+       i < m_size && m_startSeq[Index (i)] < end; ++i)
+    {
+      uint32_t k = Index (i);
+      if (!m_sacked[k] && start <= m_startSeq[k] && m_endSeq[k] <= end)
+        {
+          uint32_t size = m_endSeq[k] - m_startSeq[k];
+          m_sacked[k] = 1;
+          bytes += size;
+          if (i < m_lostEnd)
+            {
+              m_lostBytes -= size;
+              m_lostSacked += size;
+            }
+          if (i < m_rxtEnd && m_retx[k])
+            {
+              m_rxtBytes -= size;
+            }
+        }
+    }
+  m_sackedBytes += bytes;
+  return bytes;
+}
+
+void
+TcpSentSegmentTable::UpdatePipe (SequenceNumber32 highRxt, uint32_t lostThreshold)
+{
+  if (!m_pipeValid || lostThreshold != m_lostThreshold || highRxt < m_highRxt)
+    { // Start both prefixes over
+      m_pipeValid = true;
+      m_lostThreshold = lostThreshold;
+      m_lostEnd = 0;
+      m_lostBytes = 0;
+      m_lostSacked = 0;
+      m_rxtEnd = 0;
+      m_rxtBytes = 0;
+    }
+  m_highRxt = highRxt;
+
+  // A segment is lost if more than lostThreshold bytes above it are SACKed
+  while (m_lostEnd < m_size)
+    {
+      uint32_t k = Index (m_lostEnd);
+      uint32_t bytes = m_endSeq[k] - m_startSeq[k];
+      uint32_t sackedAbove = m_sackedBytes - m_lostSacked - (m_sacked[k] ? bytes : 0);
+      if (sackedAbove <= lostThreshold)
+        {
+          break;
+        }
+      if (m_sacked[k])
+        {
+          m_lostSacked += bytes;
+        }
+      else
+        {
+          m_lostBytes += bytes;
+        }
+      m_lostEnd++;
+    }
+
+  // Retransmissions count once more if wholly below highRxt, the segments
+  // NextLost () no longer returns
+  while (m_rxtEnd < m_size && m_endSeq[Index (m_rxtEnd)] <= highRxt)
+    {
+      uint32_t k = Index (m_rxtEnd);
+      if (m_retx[k] && !m_sacked[k])
+        {
+          m_rxtBytes += m_endSeq[k] - m_startSeq[k];
+        }
+      m_rxtEnd++;
+    }
+}
+
+uint32_t
+TcpSentSegmentTable::Pipe (SequenceNumber32 highRxt, uint32_t lostThreshold)
+{
+  UpdatePipe (highRxt, lostThreshold);
+  // Not SACKed and not lost, plus the retransmissions still in the network
+  return m_heldBytes - m_sackedBytes - m_lostBytes + m_rxtBytes;
+}
+
+uint32_t
+TcpSentSegmentTable::NextLost (SequenceNumber32 highRxt, uint32_t lostThreshold)
+{
+  UpdatePipe (highRxt, lostThreshold);
+  for (uint32_t i = LowerBound (highRxt + SequenceNumber32 (1)); i < m_lostEnd; ++i)
+    {
+      if (!m_sacked[Index (i)])
+        {
+          return i;
+        }
+    }
+  return m_size;
+}
+
+SequenceNumber32
+TcpSentSegmentTable::NextUnsacked (SequenceNumber32 seq) const
+{
+  for (uint32_t i = LowerBound (seq + SequenceNumber32 (1));
+       i < m_size && m_startSeq[Index (i)] <= seq && m_sacked[Index (i)]; ++i)
+    {
+      seq = m_endSeq[Index (i)];
+    }
+  return seq;
+}
+
+void
+TcpSentSegmentTable::Clear (void)
+{
+  m_head = 0;
+  m_size = 0;
+  m_sackedBytes = 0;
+  m_heldBytes = 0;
+  m_pipeValid = false;
+  m_lostEnd = 0;
+  m_lostBytes = 0;
+  m_lostSacked = 0;
+  m_rxtEnd = 0;
+  m_rxtBytes = 0;
+}
+
+uint32_t
+TcpSentSegmentTable::Find (SequenceNumber32 endSeq) const
+{
+  uint32_t i = LowerBound (endSeq);
+  if (i < m_size && m_endSeq[Index (i)] == endSeq)
+    {
+      return i;
+    }
+  return m_size;
+}
+
+uint32_t
+TcpSentSegmentTable::Size (void) const
+{
+  return m_size;
+}
+
+SequenceNumber32
+TcpSentSegmentTable::GetStartSeq (uint32_t i) const
+{
+  return m_startSeq[Index (i)];
+}
+
+SequenceNumber32
+TcpSentSegmentTable::GetEndSeq (uint32_t i) const
+{
+  return m_endSeq[Index (i)];
+}
+
+Time
+TcpSentSegmentTable::GetFirstSentTime (uint32_t i) const
+{
+  return m_firstSentTime[Index (i)];
+}
+
+Time
+TcpSentSegmentTable::GetSentTime (uint32_t i) const
+{
+  return m_sentTime[Index (i)];
+}
+
+uint32_t
+TcpSentSegmentTable::GetBytesSentSnapshot (uint32_t i) const
+{
+  return m_bytesSentSnapshot[Index (i)];
+}
+
+uint32_t
+TcpSentSegmentTable::GetDeliveredSnapshot (uint32_t i) const
+{
+  return m_deliveredSnapshot[Index (i)];
+}
+
+bool
+TcpSentSegmentTable::IsRetransmitted (uint32_t i) const
+{
+  return m_retx[Index (i)] != 0;
+}
+
+bool
+TcpSentSegmentTable::IsSacked (uint32_t i) const
+{
+  return m_sacked[Index (i)] != 0;
+}
+
+uint32_t
+TcpSentSegmentTable::GetBytesSent (void) const
+{
+  return m_bytesSent;
+}
+
+uint32_t
+TcpSentSegmentTable::GetDelivered (void) const
+{
+  return m_delivered;
+}
+
+uint32_t
+TcpSentSegmentTable::GetSackedBytes (void) const
+{
+  return m_sackedBytes;
+}
+
+uint32_t
+TcpSentSegmentTable::GetAllocations (void) const
+{
+  return m_allocations;
+}
+
+uint32_t
+TcpSentSegmentTable::GetPeakSegments (void) const
+{
+  return m_peakSize;
+}
+
+uint32_t
+TcpSentSegmentTable::GetAllocatedBytes (void) const
+{
+  return m_capacity * (2 * sizeof (SequenceNumber32) + 4 * sizeof (Time)
+                       + 2 * sizeof (uint32_t) + 3 * sizeof (uint8_t));
+}
+
+uint32_t
+TcpSentSegmentTable::LowerBound (SequenceNumber32 endSeq) const
+{
+  // On ACK arrival the wanted segment is almost always at the head
+  if (m_size == 0 || endSeq <= m_endSeq[m_head])
+    {
+      return 0;
+    }
+  uint32_t lo = 1;
+  uint32_t hi = m_size;
+  while (lo < hi)
+    {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (m_endSeq[Index (mid)] < endSeq)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  return lo;
+}
+
+uint32_t
+TcpSentSegmentTable::Index (uint32_t offset) const
+{
+  return (m_head + offset) & (m_capacity - 1);
+}
+
+void
+TcpSentSegmentTable::Split (SequenceNumber32 seq)
+{
+  uint32_t i = LowerBound (seq + SequenceNumber32 (1));
+  if (i == m_size || m_startSeq[Index (i)] >= seq)
+    { // No segment straddles seq
+      return;
+    }
+  if (m_size == m_capacity)
+    {
+      Grow ();
+    }
+  for (uint32_t j = m_size; j > i; --j)
+    {
+      Move (Index (j), Index (j - 1));
+    }
+  // Both parts keep the state of the segment, and the bytes are held once
+  m_endSeq[Index (i)] = seq;
+  m_startSeq[Index (i + 1)] = seq;
+  m_size++;
+  m_peakSize = std::max (m_peakSize, m_size);
+  m_pipeValid = false; // Offsets shift
+}
+
+void
+TcpSentSegmentTable::Move (uint32_t to, uint32_t from)
+{
+  m_startSeq[to] = m_startSeq[from];
+  m_endSeq[to] = m_endSeq[from];
+  m_firstSentTime[to] = m_firstSentTime[from];
+  m_sentTime[to] = m_sentTime[from];
+  m_bytesSentSnapshot[to] = m_bytesSentSnapshot[from];
+  m_deliveredSnapshot[to] = m_deliveredSnapshot[from];
+  m_deliveredTimeSnapshot[to] = m_deliveredTimeSnapshot[from];
+  m_intervalStartSnapshot[to] = m_intervalStartSnapshot[from];
+  m_appLimitedSnapshot[to] = m_appLimitedSnapshot[from];
+  m_retx[to] = m_retx[from];
+  m_sacked[to] = m_sacked[from];
+}
+
+template <typename T>
+static void
+Unroll (std::vector<T>& v, uint32_t head, uint32_t size, uint32_t capacity)
+{
+  std::vector<T> w (capacity);
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      w[i] = v[(head + i) & (v.size () - 1)];
+    }
+  v.swap (w);
+}
+
+void
+TcpSentSegmentTable::Grow (void)
+{
+  uint32_t capacity = m_capacity ? 2 * m_capacity : 64;
+  NS_LOG_LOGIC ("Growing table to " << capacity << " segments");
+  if (m_capacity == 0)
+    {
+      m_startSeq.resize (capacity);
+      m_endSeq.resize (capacity);
+      m_firstSentTime.resize (capacity);
+      m_sentTime.resize (capacity);
+      m_bytesSentSnapshot.resize (capacity);
+      m_deliveredSnapshot.resize (capacity);
+      m_deliveredTimeSnapshot.resize (capacity);
+      m_intervalStartSnapshot.resize (capacity);
+      m_appLimitedSnapshot.resize (capacity);
+      m_retx.resize (capacity);
+      m_sacked.resize (capacity);
+    }
+  else
+    {
+      Unroll (m_startSeq, m_head, m_size, capacity);
+      Unroll (m_endSeq, m_head, m_size, capacity);
+      Unroll (m_firstSentTime, m_head, m_size, capacity);
+      Unroll (m_sentTime, m_head, m_size, capacity);
+      Unroll (m_bytesSentSnapshot, m_head, m_size, capacity);
+      Unroll (m_deliveredSnapshot, m_head, m_size, capacity);
+      Unroll (m_deliveredTimeSnapshot, m_head, m_size, capacity);
+      Unroll (m_intervalStartSnapshot, m_head, m_size, capacity);
+      Unroll (m_appLimitedSnapshot, m_head, m_size, capacity);
+      Unroll (m_retx, m_head, m_size, capacity);
+      Unroll (m_sacked, m_head, m_size, capacity);
+    }
+  m_head = 0;
+  m_capacity = capacity;
+  m_allocations++;
+}
+
+} // namespace ns3
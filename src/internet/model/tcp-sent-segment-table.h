@@ -0,0 +1,240 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef TCP_SENT_SEGMENT_TABLE_H
+#define TCP_SENT_SEGMENT_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/nstime.h"
+#include "ns3/sequence-number.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief A delivery rate sample, taken when data is cumulatively acknowledged
+ */
+struct TcpRateSample
+{
+  TcpRateSample (void);
+
+  uint32_t delivered;      //!< Bytes delivered over the interval
+  uint32_t priorDelivered; //!< Delivered count when the segment closing the interval was sent
+  Time interval;           //!< Longer of the send and ACK intervals, zero if no sample
+  bool appLimited;         //!< The application limited the sender during the interval
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Per-segment send state of a TCP socket
+ *
+ * TcpSocketBase records every data segment it sends in this table, and
+ * RTT sampling as well as congestion controllers query it instead of
+ * keeping their own per-segment lists.
+ *
+ * The table is a structure of arrays laid out as one circular buffer
+ * (capacity is a power of two) ordered by the segments' end sequence
+ * numbers. New segments append at the tail and acknowledged ones are
+ * dropped from the head, both in O(1) amortized. A segment is looked up
+ * by its end sequence (i.e. the ACK number acknowledging it); the head
+ * is checked first, then a binary search is done over the ring.
+ *
+ * A retransmission updates the entries it covers, after splitting those
+ * straddling its edges, so that entries never overlap and each byte is
+ * held once. The entries a retransmission covers are flagged, so that RTT
+ * sampling can honour Karn's algorithm.
+ *
+ * Two running counters are kept: bytes sent (including retransmissions)
+ * and bytes delivered (cumulatively acknowledged). Each entry stores the
+ * value of the first at its first transmission, of the second at its
+ * last; "bytes sent since this segment left" is the difference between
+ * the counter and the snapshot.
+ *
+ * Delivery rate samples follow draft-cheng-iccrg-delivery-rate-estimation.
+ * Each transmission also records when data was last delivered, when the
+ * send interval it belongs to started, and whether the application was
+ * limiting the sender. When data is acknowledged, the most recently sent
+ * of the segments it covers gives the sample: the bytes delivered since
+ * that segment left, over the longer of the time it took to send them and
+ * the time it took to acknowledge them.
+ *
+ * When SACK is in use, the table is also the sender's scoreboard: the
+ * segments covered by SACK blocks are flagged, and Pipe () and
+ * NextLost () implement the SetPipe () and NextSeg () rules of RFC 6675.
+ * The SACKed bytes above a segment only decrease with its offset, so the
+ * lost segments are a prefix of the table; so are the segments ending at
+ * or below HighRxt. Both prefixes and their byte counts are kept up to
+ * date as segments are sent, SACKed and discarded, and only extended when
+ * the SACKed bytes or HighRxt grow: Pipe () is O(1) amortized.
+ */
+class TcpSentSegmentTable
+{
+public:
+  TcpSentSegmentTable (void);
+
+  /**
+   * \brief Record the transmission of a data segment
+   * \param seq first sequence number of the segment
+   * \param size size of the segment, in bytes
+   */
+  void Sent (SequenceNumber32 seq, uint32_t size);
+
+  /**
+   * \brief Account bytes cumulatively acknowledged by the peer and take a
+   *        delivery rate sample from the segments they cover
+   *
+   * Called before DiscardUpTo ().
+   *
+   * \param ack the cumulative acknowledgement number
+   * \param bytes number of newly acknowledged bytes
+   * \returns the sample, with a zero interval if no whole segment was acknowledged
+   */
+  TcpRateSample Delivered (SequenceNumber32 ack, uint32_t bytes);
+
+  /**
+   * \brief Note that the application has no more data to send for now
+   *
+   * Samples of the segments sent from now until this data in flight is
+   * delivered are flagged application limited.
+   *
+   * \param inFlight bytes in flight
+   */
+  void AppLimited (uint32_t inFlight);
+
+  /**
+   * \brief Drop the segments ending at or before the sequence number
+   * \param ack the cumulative acknowledgement number
+   */
+  void DiscardUpTo (SequenceNumber32 ack);
+
+  /**
+   * \brief Flag the segments covered by a SACK block
+   * \param start left edge of the block
+   * \param end right edge of the block
+   * \returns the number of newly SACKed bytes
+   */
+  uint32_t MarkSacked (SequenceNumber32 start, SequenceNumber32 end);
+
+  /**
+   * \brief Estimate the data in flight during loss recovery (RFC 6675 SetPipe)
+   *
+   * Every segment not SACKed counts unless it is deemed lost, and counts
+   * once more if it was retransmitted and ends at or below highRxt.
+   *
+   * \param highRxt highest sequence number retransmitted in the recovery
+   * \param lostThreshold SACKed bytes above a segment for it to be lost
+   * \returns the estimate, in bytes
+   */
+  uint32_t Pipe (SequenceNumber32 highRxt, uint32_t lostThreshold);
+
+  /**
+   * \brief Find the first segment to retransmit (RFC 6675 NextSeg rule 1)
+   * \param highRxt highest sequence number retransmitted in the recovery
+   * \param lostThreshold SACKed bytes above a segment for it to be lost
+   * \returns the offset of the first lost segment ending after highRxt,
+   *          or Size () if none
+   */
+  uint32_t NextLost (SequenceNumber32 highRxt, uint32_t lostThreshold);
+
+  /**
+   * \brief Skip the SACKed segments starting at a sequence number
+   * \param seq the sequence number
+   * \returns the first sequence number from seq not covered by a SACKed segment
+   */
+  SequenceNumber32 NextUnsacked (SequenceNumber32 seq) const;
+
+  /**
+   * \brief Drop all segments, keeping the counters
+   */
+  void Clear (void);
+
+  /**
+   * \brief Find the segment ending at a sequence number
+   * \param endSeq the sequence number following the segment
+   * \returns the offset of the segment from the head, or Size () if none
+   */
+  uint32_t Find (SequenceNumber32 endSeq) const;
+
+  uint32_t Size (void) const; //!< Number of segments in the table
+
+  // Per-segment fields, by offset from the head (oldest segment)
+  SequenceNumber32 GetStartSeq (uint32_t i) const;    //!< First sequence number of the segment
+  SequenceNumber32 GetEndSeq (uint32_t i) const;      //!< Sequence number following the segment
+  Time GetFirstSentTime (uint32_t i) const;           //!< Time of the first transmission
+  Time GetSentTime (uint32_t i) const;                //!< Time of the last (re)transmission
+  uint32_t GetBytesSentSnapshot (uint32_t i) const;   //!< Bytes sent counter at first transmission
+  uint32_t GetDeliveredSnapshot (uint32_t i) const;   //!< Bytes delivered counter at last transmission
+  bool IsRetransmitted (uint32_t i) const;            //!< The segment was sent more than once
+  bool IsSacked (uint32_t i) const;                   //!< The segment is covered by a SACK block
+
+  uint32_t GetBytesSent (void) const;  //!< Running count of bytes sent
+  uint32_t GetDelivered (void) const;  //!< Running count of bytes delivered
+  uint32_t GetSackedBytes (void) const; //!< Bytes of the SACKed segments in the table
+
+  uint32_t GetAllocations (void) const;    //!< Number of times the storage was allocated
+  uint32_t GetPeakSegments (void) const;   //!< Largest number of segments held at once
+  uint32_t GetAllocatedBytes (void) const; //!< Bytes currently allocated for the storage
+
+private:
+  uint32_t LowerBound (SequenceNumber32 endSeq) const; //!< Offset of first segment ending at or after endSeq
+  uint32_t Index (uint32_t offset) const;              //!< Ring index of the segment at offset from head
+  void Move (uint32_t to, uint32_t from);              //!< Copy a segment between ring indices
+  void Grow (void);                                    //!< Double the capacity, keeping the order
+  void Split (SequenceNumber32 seq);                   //!< Split the segment straddling seq in two
+  void UpdatePipe (SequenceNumber32 highRxt, uint32_t lostThreshold); //!< Extend the lost and HighRxt prefixes
+  void Forget (uint32_t bytes);                        //!< Remove bytes of the head from the counters
+
+  std::vector<SequenceNumber32> m_startSeq;
+  std::vector<SequenceNumber32> m_endSeq;
+  std::vector<Time>             m_firstSentTime;
+  std::vector<Time>             m_sentTime;
+  std::vector<uint32_t>         m_bytesSentSnapshot;
+  std::vector<uint32_t>         m_deliveredSnapshot;
+  std::vector<Time>             m_deliveredTimeSnapshot;
+  std::vector<Time>             m_intervalStartSnapshot;
+  std::vector<uint8_t>          m_appLimitedSnapshot;
+  std::vector<uint8_t>          m_retx;
+  std::vector<uint8_t>          m_sacked;
+
+  uint32_t m_head;        //!< Ring index of the oldest segment
+  uint32_t m_size;        //!< Number of segments in the ring
+  uint32_t m_capacity;    //!< Ring capacity, a power of two
+  uint32_t m_bytesSent;   //!< Running count of bytes sent
+  uint32_t m_delivered;   //!< Running count of bytes delivered
+  Time m_deliveredTime;   //!< Last time bytes were delivered
+  Time m_intervalStart;   //!< Start of the current send interval
+  uint32_t m_appLimited;  //!< Delivered count ending the application limited period, 0 if none
+  uint32_t m_sackedBytes; //!< Bytes of the SACKed segments
+  uint32_t m_heldBytes;   //!< Bytes of the segments
+
+  // Scoreboard prefixes, for Pipe () and NextLost ()
+  bool m_pipeValid;          //!< The prefixes match the segments, m_lostThreshold and m_highRxt
+  uint32_t m_lostThreshold;  //!< SACKed bytes above a segment for it to be lost
+  SequenceNumber32 m_highRxt; //!< HighRxt the prefixes were extended to
+  uint32_t m_lostEnd;        //!< Segments below this offset are deemed lost
+  uint32_t m_lostBytes;      //!< Bytes of the lost segments not SACKed
+  uint32_t m_lostSacked;     //!< Bytes of the SACKed segments below m_lostEnd
+  uint32_t m_rxtEnd;         //!< Segments below this offset end at or below m_highRxt
+  uint32_t m_rxtBytes;       //!< Bytes of the retransmitted segments below m_rxtEnd not SACKed
+  uint32_t m_allocations; //!< Number of storage allocations
+  uint32_t m_peakSize;    //!< Largest m_size seen
+};
+
+} // namespace ns3
+
+#endif /* TCP_SENT_SEGMENT_TABLE_H */
@@ -39,6 +39,7 @@
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/trace-source-accessor.h"
 #include "tcp-socket-base.h"
 #include "tcp-l4-protocol.h"
@@ -72,10 +73,41 @@ TcpSocketBase::GetTypeId (void)
                    DoubleValue (120), /* RFC793 says MSL=2 minutes*/
                    MakeDoubleAccessor (&TcpSocketBase::m_msl),
                    MakeDoubleChecker<double> (0))
-    .AddAttribute ("MaxWindowSize", "Max size of advertised window",
+    .AddAttribute ("MaxWindowSize", "Max size of advertised window, above 65535 only with window scaling",
                    UintegerValue (65535),
                    MakeUintegerAccessor (&TcpSocketBase::m_maxWinSize),
-                   MakeUintegerChecker<uint16_t> ())
+                   MakeUintegerChecker<uint32_t> (0, 65535u << 14))
+    .AddAttribute ("OffloadSize", "Largest burst of new data, in bytes, copied, tagged and given "
+                   "its header at once, then cut into segments. 0 sends segment by segment.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpSocketBase::m_offloadSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Pacing", "Release segments at the pacing rate, from the pacing wheel of the node, "
+                   "instead of sending the available window at once",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_pacing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PacingGain", "Gain of the default pacing rate over a window per smoothed RTT",
+                   DoubleValue (1.2),
+                   MakeDoubleAccessor (&TcpSocketBase::m_pacingGain),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Prr", "Use proportional rate reduction (RFC 6937) in fast recovery, "
+                   "with the congestion controls supporting it",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_prr),
+                   MakeBooleanChecker ())
+    .AddAttribute ("WindowScaling", "Negotiate the window scale option (RFC 7323)",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&TcpSocketBase::m_winScalingEnabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Sack", "Negotiate and use selective acknowledgements (RFC 2018)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_sackEnabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Timestamp", "Negotiate the timestamps option (RFC 7323)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_timestampEnabled),
+                   MakeBooleanChecker ())
     .AddAttribute ("IcmpCallback", "Callback invoked whenever an icmp error is received on this socket.",
                    CallbackValue (),
                    MakeCallbackAccessor (&TcpSocketBase::m_icmpCallback),
@@ -90,6 +122,12 @@ TcpSocketBase::GetTypeId (void)
     .AddTraceSource ("RTT",
                      "Last RTT sample",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_lastRtt))
+    .AddTraceSource ("RttSample",
+                     "RTT measured on every ACK, with the timestamps option",
+                     MakeTraceSourceAccessor (&TcpSocketBase::m_rttSample))
+    .AddTraceSource ("DeliveryRate",
+                     "Delivery rate sampled on every new ACK, and whether the application limited it",
+                     MakeTraceSourceAccessor (&TcpSocketBase::m_deliveryRateTrace))
     .AddTraceSource ("NextTxSequence",
                      "Next sequence number to send (SND.NXT)",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_nextTxSequence))
@@ -127,8 +165,34 @@ TcpSocketBase::TcpSocketBase (void)
     m_shutdownRecv (false),
     m_connected (false),
     m_segmentSize (0),
+    m_offloadSize (0),
     // For attribute initialization consistency (quiet valgrind)
-    m_rWnd (0)
+    m_rWnd (0),
+    m_pacing (false),
+    m_pacingGain (1.2),
+    m_winScalingEnabled (true),
+    m_winScalingPermitted (false),
+    m_sndWindShift (0),
+    m_rcvWindShift (0),
+    m_timestampEnabled (false),
+    m_timestampPermitted (false),
+    m_tsRecent (0),
+    m_tsEcr (0),
+    m_tsEcrValid (false),
+    m_lastAckSent (0),
+    m_sackEnabled (false),
+    m_sackPermitted (false),
+    m_sackRecovery (false),
+    m_prr (false),
+    m_prrActive (false),
+    m_prrSsThresh (0),
+    m_prrRecoverFs (0),
+    m_prrStart (0),
+    m_prrSentStart (0),
+    m_prrDupBytes (0),
+    m_prrDelivered (0),
+    m_prrSndCnt (0),
+    m_prrSentMark (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -163,7 +227,33 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
     m_msl (sock.m_msl),
     m_segmentSize (sock.m_segmentSize),
     m_maxWinSize (sock.m_maxWinSize),
-    m_rWnd (sock.m_rWnd)
+    m_offloadSize (sock.m_offloadSize),
+    m_rWnd (sock.m_rWnd),
+    m_pacing (sock.m_pacing),
+    m_pacingGain (sock.m_pacingGain),
+    m_winScalingEnabled (sock.m_winScalingEnabled),
+    m_winScalingPermitted (sock.m_winScalingPermitted),
+    m_sndWindShift (sock.m_sndWindShift),
+    m_rcvWindShift (sock.m_rcvWindShift),
+    m_timestampEnabled (sock.m_timestampEnabled),
+    m_timestampPermitted (sock.m_timestampPermitted),
+    m_tsRecent (sock.m_tsRecent),
+    m_tsEcr (0),
+    m_tsEcrValid (false),
+    m_lastAckSent (sock.m_lastAckSent),
+    m_sackEnabled (sock.m_sackEnabled),
+    m_sackPermitted (sock.m_sackPermitted),
+    m_sackRecovery (false),
+    m_prr (sock.m_prr),
+    m_prrActive (false),
+    m_prrSsThresh (0),
+    m_prrRecoverFs (0),
+    m_prrStart (0),
+    m_prrSentStart (0),
+    m_prrDupBytes (0),
+    m_prrDelivered (0),
+    m_prrSndCnt (0),
+    m_prrSentMark (0)
 {
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC ("Invoked the copy constructor");
@@ -419,6 +509,11 @@ TcpSocketBase::Connect (const Address & address)
 
   // Re-initialize parameters in case this socket is being reused after CLOSE
   m_rtt->Reset ();
+  m_sentTable.Clear ();
+  m_sackBlocks.clear ();
+  m_sackRecovery = false;
+  m_sndWindShift = 0;
+  m_rcvWindShift = m_winScalingEnabled ? CalculateWScale () : 0;
   m_cnCount = m_cnRetries;
 
   // DoConnect() will do state-checking and send a SYN packet
@@ -607,6 +702,62 @@ TcpSocketBase::RecvFrom (uint32_t maxSize, uint32_t flags, Address &fromAddress)
   return packet;
 }
 
+int
+TcpSocketBase::SpliceTo (Ptr<TcpSocketBase> dst, uint32_t maxBytes)
+{
+  NS_LOG_FUNCTION (this << dst << maxBytes);
+  if (dst->m_state != ESTABLISHED && dst->m_state != SYN_SENT && dst->m_state != CLOSE_WAIT)
+    {
+      dst->m_errno = ERROR_NOTCONN;
+      return -1;
+    }
+  if (dst->m_shutdownSend)
+    {
+      dst->m_errno = ERROR_SHUTDOWN;
+      return -1;
+    }
+  uint32_t size = std::min (maxBytes, std::min (m_rxBuffer.Available (), dst->m_txBuffer.Available ()));
+  if (size == 0)
+    {
+      return 0;
+    }
+  Ptr<Packet> p = m_rxBuffer.Extract (size);
+  if (!dst->m_txBuffer.Add (p))
+    { // Cannot happen, the space was checked above
+      NS_FATAL_ERROR ("Tx buffer overflow while splicing " << size << " bytes");
+    }
+  NS_LOG_LOGIC ("Spliced " << p->GetSize () << " bytes, txBufSize=" << dst->m_txBuffer.Size ());
+  if (dst->m_state == ESTABLISHED || dst->m_state == CLOSE_WAIT)
+    {
+      dst->SendPendingData (dst->m_connected);
+    }
+  return p->GetSize ();
+}
+
+int
+TcpSocketBase::Abort (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_state == CLOSED)
+    {
+      return 0;
+    }
+  if (m_state != LISTEN && m_state != TIME_WAIT)
+    {
+      SendRST ();
+    }
+  else
+    {
+      NotifyErrorClose ();
+      DeallocateEndPoint ();
+    }
+  m_closeNotified = true;
+  NS_LOG_INFO (TcpStateName[m_state] << " -> CLOSED");
+  CancelAllTimers ();
+  m_state = CLOSED;
+  return 0;
+}
+
 /* Inherit from Socket class: Get the max number of bytes an app can send */
 uint32_t
 TcpSocketBase::GetTxAvailable (void) const
@@ -860,11 +1011,11 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, Ipv4Header header, uint16_t port
   // Peel off TCP header and do validity checking
   TcpHeader tcpHeader;
   packet->RemoveHeader (tcpHeader);
+  ReadOptions (packet, tcpHeader);
   if (tcpHeader.GetFlags () & TcpHeader::ACK)
     {
       EstimateRtt (tcpHeader);
     }
-  ReadOptions (tcpHeader);
 
   // Update Rx window size, i.e. the flow control window
   if (m_rWnd.Get () == 0 && tcpHeader.GetWindowSize () != 0)
@@ -872,7 +1023,8 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, Ipv4Header header, uint16_t port
       NS_LOG_LOGIC (this << " Leaving zerowindow persist state");
       m_persistEvent.Cancel ();
     }
-  m_rWnd = tcpHeader.GetWindowSize ();
+  m_rWnd = (tcpHeader.GetFlags () & TcpHeader::SYN) ? tcpHeader.GetWindowSize ()
+    : static_cast<uint32_t> (tcpHeader.GetWindowSize ()) << m_sndWindShift;
 
   // Discard fully out of range data packets
   if (packet->GetSize ()
@@ -915,8 +1067,9 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, Ipv4Header header, uint16_t port
           h.SetSourcePort (tcpHeader.GetDestinationPort ());
           h.SetDestinationPort (tcpHeader.GetSourcePort ());
           h.SetWindowSize (AdvertisedWindowSize ());
-          AddOptions (h);
-          m_tcp->SendPacket (Create<Packet> (), h, header.GetDestination (), header.GetSource (), m_boundnetdevice);
+          Ptr<Packet> p = Create<Packet> ();
+          AddOptions (h, p);
+          m_tcp->SendPacket (p, h, header.GetDestination (), header.GetSource (), m_boundnetdevice);
         }
       break;
     case SYN_SENT:
@@ -955,11 +1108,11 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, Ipv6Header header, uint16_t port
   // Peel off TCP header and do validity checking
   TcpHeader tcpHeader;
   packet->RemoveHeader (tcpHeader);
+  ReadOptions (packet, tcpHeader);
   if (tcpHeader.GetFlags () & TcpHeader::ACK)
     {
       EstimateRtt (tcpHeader);
     }
-  ReadOptions (tcpHeader);
 
   // Update Rx window size, i.e. the flow control window
   if (m_rWnd.Get () == 0 && tcpHeader.GetWindowSize () != 0)
@@ -967,7 +1120,8 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, Ipv6Header header, uint16_t port
       NS_LOG_LOGIC (this << " Leaving zerowindow persist state");
       m_persistEvent.Cancel ();
     }
-  m_rWnd = tcpHeader.GetWindowSize ();
+  m_rWnd = (tcpHeader.GetFlags () & TcpHeader::SYN) ? tcpHeader.GetWindowSize ()
+    : static_cast<uint32_t> (tcpHeader.GetWindowSize ()) << m_sndWindShift;
 
   // Discard fully out of range packets
   if (packet->GetSize ()
@@ -1010,8 +1164,9 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, Ipv6Header header, uint16_t port
           h.SetSourcePort (tcpHeader.GetDestinationPort ());
           h.SetDestinationPort (tcpHeader.GetSourcePort ());
           h.SetWindowSize (AdvertisedWindowSize ());
-          AddOptions (h);
-          m_tcp->SendPacket (Create<Packet> (), h, header.GetDestinationAddress (), header.GetSourceAddress (), m_boundnetdevice);
+          Ptr<Packet> p = Create<Packet> ();
+          AddOptions (h, p);
+          m_tcp->SendPacket (p, h, header.GetDestinationAddress (), header.GetSourceAddress (), m_boundnetdevice);
         }
       break;
     case SYN_SENT:
@@ -1101,6 +1256,11 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
       if (tcpHeader.GetAckNumber () < m_nextTxSequence && packet->GetSize() == 0)
         {
           NS_LOG_LOGIC ("Dupack of " << tcpHeader.GetAckNumber ());
+          if (m_prrActive && !m_sackPermitted)
+            { // Without SACK, a dupack stands for a segment delivered (RFC 6937, sec.3)
+              m_prrDupBytes += m_segmentSize;
+            }
+          PrrUpdate ();
           DupAck (tcpHeader, ++m_dupAckCount);
         }
       // otherwise, the ACK is precisely equal to the nextTxSequence
@@ -1109,6 +1269,13 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
   else if (tcpHeader.GetAckNumber () > m_txBuffer.HeadSequence ())
     { // Case 3: New ACK, reset m_dupAckCount and update m_txBuffer
       NS_LOG_LOGIC ("New ack of " << tcpHeader.GetAckNumber ());
+      if (m_sackRecovery && tcpHeader.GetAckNumber () >= m_recoveryPoint)
+        { // All data outstanding at the start of the recovery is acknowledged
+          NS_LOG_INFO ("SACK recovery completed at ack " << tcpHeader.GetAckNumber ());
+          m_sackRecovery = false;
+        }
+      SampleDeliveryRate (tcpHeader.GetAckNumber ());
+      m_prrDupBytes = 0; // Now counted in the cumulative ACK
       NewAck (tcpHeader.GetAckNumber ());
       m_dupAckCount = 0;
     }
@@ -1623,8 +1790,8 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
       header.SetSourcePort (m_endPoint6->GetLocalPort ());
       header.SetDestinationPort (m_endPoint6->GetPeerPort ());
     }
-  header.SetWindowSize (AdvertisedWindowSize ());
-  AddOptions (header);
+  header.SetWindowSize (AdvertisedWindowSize (!(flags & TcpHeader::SYN))); // Never scaled on SYN
+  AddOptions (header, p);
   m_rto = m_rtt->RetransmitTimeout ();
   bool hasSyn = flags & TcpHeader::SYN;
   bool hasFin = flags & TcpHeader::FIN;
@@ -1821,24 +1988,15 @@ TcpSocketBase::ConnectionSucceeded ()
     }
 }
 
-/* Extract at most maxSize bytes from the TxBuffer at sequence seq, add the
-    TCP header, and send to TcpL4Protocol */
-uint32_t
-TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck)
+/*
+ * Add tags for each socket option.
+ * Note that currently the socket adds both IPv4 tag and IPv6 tag
+ * if both options are set. Once the packet got to layer three, only
+ * the corresponding tags will be read.
+ */
+void
+TcpSocketBase::AddSocketTags (Ptr<Packet> p)
 {
-  NS_LOG_FUNCTION (this << seq << maxSize << withAck);
-
-  Ptr<Packet> p = m_txBuffer.CopyFromSequence (maxSize, seq);
-  uint32_t sz = p->GetSize (); // Size of packet
-  uint8_t flags = withAck ? TcpHeader::ACK : 0;
-  uint32_t remainingData = m_txBuffer.SizeFromSequence (seq + SequenceNumber32 (sz));
-
-  /*
-   * Add tags for each socket option.
-   * Note that currently the socket adds both IPv4 tag and IPv6 tag
-   * if both options are set. Once the packet got to layer three, only
-   * the corresponding tags will be read.
-   */
   if (IsManualIpTos ())
     {
       SocketIpTosTag ipTosTag;
@@ -1866,6 +2024,21 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       ipHopLimitTag.SetHopLimit (GetIpv6HopLimit ());
       p->AddPacketTag (ipHopLimitTag);
     }
+}
+
+/* Extract at most maxSize bytes from the TxBuffer at sequence seq, add the
+    TCP header, and send to TcpL4Protocol */
+uint32_t
+TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck)
+{
+  NS_LOG_FUNCTION (this << seq << maxSize << withAck);
+
+  Ptr<Packet> p = m_txBuffer.CopyFromSequence (maxSize, seq);
+  uint32_t sz = p->GetSize (); // Size of packet
+  uint8_t flags = withAck ? TcpHeader::ACK : 0;
+  uint32_t remainingData = m_txBuffer.SizeFromSequence (seq + SequenceNumber32 (sz));
+
+  AddSocketTags (p);
 
   if (m_closeOnEmpty && (remainingData == 0))
     {
@@ -1896,7 +2069,7 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       header.SetDestinationPort (m_endPoint6->GetPeerPort ());
     }
   header.SetWindowSize (AdvertisedWindowSize ());
-  AddOptions (header);
+  AddOptions (header, p);
   if (m_retxEvent.IsExpired () )
     { // Schedule retransmit
       m_rto = m_rtt->RetransmitTimeout ();
@@ -1916,7 +2089,10 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       m_tcp->SendPacket (p, header, m_endPoint6->GetLocalAddress (),
                          m_endPoint6->GetPeerAddress (), m_boundnetdevice);
     }
-  m_rtt->SentSeq (seq, sz);       // notify the RTT
+  if (sz > 0)
+    {
+      m_sentTable.Sent (seq, sz);   // record send state for RTT and congestion control
+    }
   // Notify the application of the data being sent unless this is a retransmit
   if (seq == m_nextTxSequence)
     {
@@ -1927,6 +2103,64 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
   return sz;
 }
 
+/* Send full segments of new data, with the per-packet work done once for
+    the burst: segments are fragments sharing its buffer, tags and header */
+uint32_t
+TcpSocketBase::SendDataBurst (SequenceNumber32 seq, uint32_t segments, bool withAck)
+{
+  NS_LOG_FUNCTION (this << seq << segments << withAck);
+
+  Ptr<Packet> burst = m_txBuffer.CopyFromSequence (segments * m_segmentSize, seq);
+  uint32_t size = burst->GetSize ();
+  AddSocketTags (burst);
+
+  TcpHeader header;
+  header.SetFlags (withAck ? TcpHeader::ACK : 0);
+  header.SetAckNumber (m_rxBuffer.NextRxSequence ());
+  if (m_endPoint)
+    {
+      header.SetSourcePort (m_endPoint->GetLocalPort ());
+      header.SetDestinationPort (m_endPoint->GetPeerPort ());
+    }
+  else
+    {
+      header.SetSourcePort (m_endPoint6->GetLocalPort ());
+      header.SetDestinationPort (m_endPoint6->GetPeerPort ());
+    }
+  header.SetWindowSize (AdvertisedWindowSize ());
+  AddOptions (header, burst); // Fragments keep the packet tags
+  if (m_retxEvent.IsExpired () )
+    { // Schedule retransmit
+      m_rto = m_rtt->RetransmitTimeout ();
+      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+    }
+  NS_LOG_LOGIC ("Send burst of " << size << " bytes from seq " << seq);
+  for (uint32_t offset = 0; offset < size; offset += m_segmentSize)
+    {
+      uint32_t sz = std::min (m_segmentSize, size - offset);
+      Ptr<Packet> p = burst->CreateFragment (offset, sz);
+      header.SetSequenceNumber (seq + SequenceNumber32 (offset));
+      if (m_endPoint)
+        {
+          m_tcp->SendPacket (p, header, m_endPoint->GetLocalAddress (),
+                             m_endPoint->GetPeerAddress (), m_boundnetdevice);
+        }
+      else
+        {
+          m_tcp->SendPacket (p, header, m_endPoint6->GetLocalAddress (),
+                             m_endPoint6->GetPeerAddress (), m_boundnetdevice);
+        }
+      m_sentTable.Sent (seq + SequenceNumber32 (offset), sz);
+    }
+  // One notification for the whole burst
+  if (seq == m_nextTxSequence)
+    {
+      Simulator::ScheduleNow (&TcpSocketBase::NotifyDataSent, this, size);
+    }
+  m_highTxMark = std::max (seq + size, m_highTxMark.Get ());
+  return size;
+}
+
 /* Send as much pending data as possible according to the Tx window. Note that
  *  this function did not implement the PSH flag
  */
@@ -1936,6 +2170,7 @@ TcpSocketBase::SendPendingData (bool withAck)
   NS_LOG_FUNCTION (this << withAck);
   if (m_txBuffer.Size () == 0)
     {
+      CheckAppLimited ();
       return false;                           // Nothing to send
 
     }
@@ -1945,8 +2180,40 @@ TcpSocketBase::SendPendingData (bool withAck)
       return false; // Is this the right way to handle this condition?
     }
   uint32_t nPacketsSent = 0;
+  // In SACK recovery, segments deemed lost are sent first (RFC 6675 NextSeg)
+  while (m_sackRecovery && AvailableWindow () >= m_segmentSize)
+    {
+      uint32_t i = m_sentTable.NextLost (m_highRxt, 2 * m_segmentSize);
+      if (i == m_sentTable.Size ())
+        {
+          break;
+        }
+      SequenceNumber32 seq = std::max (m_sentTable.GetStartSeq (i), m_highRxt);
+      if (PacingHold ())
+        {
+          return (nPacketsSent > 0);
+        }
+      uint32_t s = std::min (m_segmentSize, static_cast<uint32_t> (m_sentTable.GetEndSeq (i) - seq));
+      NS_LOG_LOGIC ("SACK recovery retransmits seq " << seq);
+      uint32_t sz = SendDataPacket (seq, s, withAck);
+      if (sz == 0)
+        {
+          break;
+        }
+      PacingSent (sz);
+      m_highRxt = seq + sz;
+      nPacketsSent++;
+    }
   while (m_txBuffer.SizeFromSequence (m_nextTxSequence))
     {
+      if (m_sackPermitted && m_nextTxSequence < m_highTxMark)
+        { // Sending again after a timeout: skip what the peer SACKed
+          m_nextTxSequence = m_sentTable.NextUnsacked (m_nextTxSequence);
+          if (m_txBuffer.SizeFromSequence (m_nextTxSequence) == 0)
+            {
+              break;
+            }
+        }
       uint32_t w = AvailableWindow (); // Get available window size
       NS_LOG_LOGIC ("TcpSocketBase " << this << " SendPendingData" <<
                     " w " << w <<
@@ -1969,11 +2236,33 @@ TcpSocketBase::SendPendingData (bool withAck)
           NS_LOG_LOGIC ("Invoking Nagle's algorithm. Wait to send.");
           break;
         }
+      if (PacingHold ())
+        {
+          break;
+        }
+      if (m_offloadSize > 0 && !m_pacing && w >= 2 * m_segmentSize && m_nextTxSequence >= m_highTxMark)
+        { // New data: full segments in one burst, the FIN goes in its own segment
+          uint32_t pending = m_txBuffer.SizeFromSequence (m_nextTxSequence);
+          uint32_t segments = std::min (std::min (w, m_offloadSize), pending) / m_segmentSize;
+          if (m_closeOnEmpty && segments * m_segmentSize == pending)
+            {
+              segments--;
+            }
+          if (segments >= 2)
+            {
+              uint32_t sz = SendDataBurst (m_nextTxSequence, segments, withAck);
+              nPacketsSent += segments;
+              m_nextTxSequence += sz;
+              continue;
+            }
+        }
       uint32_t s = std::min (w, m_segmentSize);  // Send no more than window
       uint32_t sz = SendDataPacket (m_nextTxSequence, s, withAck);
+      PacingSent (sz);
       nPacketsSent++;                             // Count sent this loop
       m_nextTxSequence += sz;                     // Advance next tx sequence
     }
+  CheckAppLimited ();
   NS_LOG_LOGIC ("SendPendingData sent " << nPacketsSent << " packets");
   return (nPacketsSent > 0);
 }
@@ -2004,17 +2293,157 @@ TcpSocketBase::AvailableWindow ()
 {
   NS_LOG_FUNCTION_NOARGS ();
   uint32_t unack = UnAckDataCount (); // Number of outstanding bytes
-  uint32_t win = Window (); // Number of bytes allowed to be outstanding
+  if (m_sackRecovery)
+    { // RFC 6675 pipe; a segment is lost once (DupThresh - 1) * SMSS is SACKed above it
+      unack = m_sentTable.Pipe (m_highRxt, 2 * m_segmentSize);
+    }
+  // Number of bytes allowed to be outstanding; PRR takes over from cwnd
+  uint32_t win = m_prrActive ? m_rWnd.Get () : Window ();
   NS_LOG_LOGIC ("UnAckCount=" << unack << ", Win=" << win);
-  return (win < unack) ? 0 : (win - unack);
+  uint32_t avail = (win < unack) ? 0 : (win - unack);
+  if (m_prrActive)
+    {
+      uint32_t sent = m_sentTable.GetBytesSent () - m_prrSentMark;
+      avail = std::min (avail, m_prrSndCnt > sent ? m_prrSndCnt - sent : 0);
+    }
+  return avail;
+}
+
+void
+TcpSocketBase::SampleDeliveryRate (SequenceNumber32 ack)
+{
+  NS_LOG_FUNCTION (this << ack);
+  m_rateSample = m_sentTable.Delivered (ack, ack - m_txBuffer.HeadSequence ());
+  if (m_rateSample.interval < m_lowestRtt)
+    { // Compressed ACKs: no interval shorter than an RTT gives a credible rate
+      NS_LOG_LOGIC ("Sample interval " << m_rateSample.interval << " below the lowest RTT, discarded");
+      m_rateSample.interval = Time ();
+    }
+  if (!m_rateSample.interval.IsStrictlyPositive ())
+    {
+      return;
+    }
+  m_deliveryRate = DataRate (static_cast<uint64_t> (m_rateSample.delivered * 8
+                                                    / m_rateSample.interval.GetSeconds ()));
+  NS_LOG_LOGIC ("Delivery rate " << m_deliveryRate << (m_rateSample.appLimited ? ", app limited" : ""));
+  m_deliveryRateTrace (m_deliveryRate, m_rateSample.appLimited);
+}
+
+void
+TcpSocketBase::CheckAppLimited ()
+{
+  // Less than a segment to send, room for more in the window: the samples
+  // of what is sent until then say more about the application than the path
+  if (!m_sackRecovery && m_txBuffer.SizeFromSequence (m_nextTxSequence) < m_segmentSize
+      && AvailableWindow () >= m_segmentSize)
+    {
+      m_sentTable.AppLimited (BytesInFlight ());
+    }
+}
+
+DataRate
+TcpSocketBase::GetPacingRate ()
+{
+  return WindowRate (m_pacingGain);
+}
+
+DataRate
+TcpSocketBase::WindowRate (double gain)
+{
+  Time srtt = m_rtt->GetCurrentEstimate ();
+  if (m_lastRtt.Get ().IsZero () || !srtt.IsStrictlyPositive ())
+    {
+      return DataRate (0);
+    }
+  return DataRate (static_cast<uint64_t> (gain * Window () * 8 / srtt.GetSeconds ()));
+}
+
+bool
+TcpSocketBase::PacingHold ()
+{
+  if (!m_pacing || Simulator::Now () >= m_nextPacedSend)
+    {
+      return false;
+    }
+  if (m_pacingTimer == 0 || !m_pacingTimer->IsPending ())
+    {
+      NS_LOG_LOGIC ("Pacing holds segments until " << m_nextPacedSend);
+      m_pacingTimer = TcpPacingWheel::GetWheel (m_node)->Schedule (m_nextPacedSend,
+                                                                   MakeCallback (&TcpSocketBase::PacedSend, this));
+    }
+  return true;
+}
+
+void
+TcpSocketBase::PacingSent (uint32_t size)
+{
+  if (!m_pacing)
+    {
+      return;
+    }
+  DataRate rate = GetPacingRate ();
+  if (rate.GetBitRate () == 0)
+    {
+      return;
+    }
+  Time interval = Seconds (rate.CalculateTxTime (size));
+  // Carry on from the previous release when the wheel was late by less than
+  // an interval, so that its rounding does not lower the rate; never build credit
+  Time now = Simulator::Now ();
+  m_nextPacedSend = (m_nextPacedSend + interval > now ? m_nextPacedSend : now) + interval;
+}
+
+void
+TcpSocketBase::PacedSend ()
+{
+  NS_LOG_FUNCTION (this);
+  m_pacingTimer = 0;
+  if (m_state == ESTABLISHED || m_state == CLOSE_WAIT || m_state == FIN_WAIT_1 || m_state == LAST_ACK)
+    {
+      SendPendingData (m_connected);
+    }
 }
 
 uint16_t
-TcpSocketBase::AdvertisedWindowSize ()
+TcpSocketBase::AdvertisedWindowSize (bool scale)
+{
+  uint8_t shift = scale ? m_rcvWindShift : 0;
+  uint32_t w = std::min (m_rxBuffer.MaxBufferSize () - m_rxBuffer.Size (), m_maxWinSize);
+  if (!m_windowCap.IsNull ())
+    {
+      w = std::min (w, m_windowCap ());
+    }
+  if (w < (65535u << shift))
+    {
+      w -= w % m_segmentSize;
+    }
+  return std::min (w >> shift, 65535u);
+}
+
+void
+TcpSocketBase::SetWindowCapCallback (Callback<uint32_t> cap)
 {
-  uint16_t res = std::min (m_rxBuffer.MaxBufferSize () - m_rxBuffer.Size (), (uint32_t)m_maxWinSize);
-  if (res == 65535u) return res;
-  return res - res % m_segmentSize;
+  NS_LOG_FUNCTION (this);
+  m_windowCap = cap;
+}
+
+uint32_t
+TcpSocketBase::TimestampNow ()
+{
+  return static_cast<uint32_t> (Simulator::Now ().GetMicroSeconds ());
+}
+
+uint8_t
+TcpSocketBase::CalculateWScale () const
+{
+  uint32_t maxSpace = std::min (m_rxBuffer.MaxBufferSize (), m_maxWinSize);
+  uint8_t scale = 0;
+  while (scale < 14 && maxSpace > 65535u)
+    {
+      maxSpace >>= 1;
+      ++scale;
+    }
+  return scale;
 }
 
 // Receipt of new packet, put into Rx buffer
@@ -2033,6 +2462,10 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
       SendEmptyPacket (TcpHeader::ACK);
       return;
     }
+  if (m_sackPermitted)
+    {
+      UpdateSackBlocks (tcpHeader.GetSequenceNumber (), p->GetSize ());
+    }
   // Now send a new ACK packet acknowledging all received and delivered data
   if (m_rxBuffer.Size () > m_rxBuffer.Available () || m_rxBuffer.NextRxSequence () > expectedSeq + p->GetSize ())
     { // A gap exists in the buffer, or we filled a gap: Always ACK
@@ -2078,19 +2511,42 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
 void
 TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
 {
-  // Use m_rtt for the estimation. Note, RTT of duplicated acknowledgement
-  // (which should be ignored) is handled by m_rtt. Once timestamp option
-  // is implemented, this function would be more elaborated.
-  Time nextRtt =  m_rtt->AckSeq (tcpHeader.GetAckNumber () );
-
-  //nextRtt will be zero for dup acks.  Don't want to update lastRtt in that case
-  //but still needed to do list clearing that is done in AckSeq. 
-  if(nextRtt != 0)
-  {
-    m_lastRtt = nextRtt;
-    NS_LOG_FUNCTION(this << m_lastRtt);
-  }
-  
+  // With timestamps, the echoed value gives an unambiguous sample on every
+  // ACK, duplicated ones included. Otherwise, sample the RTT of the oldest
+  // outstanding segment if this ACK covers it and it was sent only once
+  // (Karn's algorithm).
+  SequenceNumber32 ack = tcpHeader.GetAckNumber ();
+  if (m_timestampPermitted && m_tsEcrValid && !(tcpHeader.GetFlags () & TcpHeader::SYN))
+    {
+      Time rtt = MicroSeconds (TimestampNow () - m_tsEcr);
+      m_rttSample (rtt);
+      if (ack > m_txBuffer.HeadSequence ())
+        {
+          m_rtt->Measurement (rtt);
+          m_rtt->ResetMultiplier ();
+          m_lastRtt = rtt;
+          if (rtt.IsStrictlyPositive () && (m_lowestRtt.IsZero () || rtt < m_lowestRtt))
+            {
+              m_lowestRtt = rtt;
+            }
+          NS_LOG_FUNCTION (this << m_lastRtt);
+        }
+      return;
+    }
+  if (m_sentTable.Size () == 0 || ack <= m_txBuffer.HeadSequence ()
+      || ack < m_sentTable.GetEndSeq (0) || m_sentTable.IsRetransmitted (0))
+    {
+      return;
+    }
+  Time nextRtt = Simulator::Now () - m_sentTable.GetSentTime (0);
+  m_rtt->Measurement (nextRtt);
+  m_rtt->ResetMultiplier ();
+  m_lastRtt = nextRtt;
+  if (nextRtt.IsStrictlyPositive () && (m_lowestRtt.IsZero () || nextRtt < m_lowestRtt))
+    {
+      m_lowestRtt = nextRtt;
+    }
+  NS_LOG_FUNCTION (this << m_lastRtt);
 }
 
 // Called by the ReceivedAck() when new ACK received and by ProcessSynRcvd()
@@ -2128,7 +2584,9 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack)
   // Note the highest ACK and tell app to send more
   NS_LOG_LOGIC ("TCP " << this << " NewAck " << ack <<
                 " numberAck " << (ack - m_txBuffer.HeadSequence ())); // Number bytes ack'ed
+  m_sentTable.DiscardUpTo (ack);
   m_txBuffer.DiscardUpTo (ack);
+  PrrUpdate ();
   if (GetTxAvailable () > 0)
     {
       NotifySend (GetTxAvailable ());
@@ -2165,6 +2623,7 @@ TcpSocketBase::ReTxTimeout ()
 	  return;
     }
 
+  m_sackRecovery = false;
   Retransmit ();
 }
 
@@ -2214,7 +2673,7 @@ TcpSocketBase::PersistTimeout ()
       tcpHeader.SetSourcePort (m_endPoint6->GetLocalPort ());
       tcpHeader.SetDestinationPort (m_endPoint6->GetPeerPort ());
     }
-  AddOptions (tcpHeader);
+  AddOptions (tcpHeader, p);
 
   if (m_endPoint != 0)
     {
@@ -2275,6 +2734,90 @@ TcpSocketBase::DoRetransmit ()
 
 }
 
+void
+TcpSocketBase::FastRetransmit ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_sackPermitted && !m_sackRecovery)
+    {
+      NS_LOG_INFO ("Entering SACK recovery, recovery point " << m_highTxMark);
+      m_sackRecovery = true;
+      m_recoveryPoint = m_highTxMark;
+    }
+  DoRetransmit ();
+  if (m_sackRecovery)
+    { // DoRetransmit () resent the first segment
+      m_highRxt = std::min (m_txBuffer.HeadSequence () + m_segmentSize, m_highTxMark.Get ());
+    }
+}
+
+void
+TcpSocketBase::PrrStart (uint32_t ssThresh)
+{
+  NS_LOG_FUNCTION (this << ssThresh);
+  m_prrActive = true;
+  m_prrSsThresh = ssThresh;
+  m_prrRecoverFs = BytesInFlight ();
+  m_prrStart = m_sentTable.GetDelivered () + m_sentTable.GetSackedBytes ();
+  m_prrSentStart = m_sentTable.GetBytesSent ();
+  m_prrDupBytes = 0;
+  m_prrDelivered = 0;
+  m_prrSndCnt = 0;
+  m_prrSentMark = m_prrSentStart;
+}
+
+void
+TcpSocketBase::PrrStop ()
+{
+  NS_LOG_FUNCTION (this);
+  m_prrActive = false;
+}
+
+/* RFC 6937, sec.3: send in proportion to the data delivered while the data
+   in flight is above ssthresh, then grow it back to ssthresh no faster than
+   slow start (the reduction bound). Called once the scoreboard and the
+   sent segment table agree, before sending. */
+void
+TcpSocketBase::PrrUpdate ()
+{
+  if (!m_prrActive)
+    {
+      return;
+    }
+  // SACKed bytes count until cumulatively acknowledged, then as delivered
+  uint32_t delivered = m_sentTable.GetDelivered () + m_sentTable.GetSackedBytes ()
+    - m_prrStart + m_prrDupBytes;
+  uint32_t deliveredData = delivered > m_prrDelivered ? delivered - m_prrDelivered : 0;
+  m_prrDelivered = delivered;
+  uint32_t prrOut = m_sentTable.GetBytesSent () - m_prrSentStart;
+  uint32_t pipe;
+  if (m_sackRecovery)
+    {
+      pipe = m_sentTable.Pipe (m_highRxt, 2 * m_segmentSize);
+    }
+  else
+    { // No scoreboard: what was in flight, plus what was sent, less what left
+      pipe = m_prrRecoverFs + prrOut > m_prrDelivered ? m_prrRecoverFs + prrOut - m_prrDelivered : 0;
+    }
+  int64_t sndcnt;
+  if (pipe > m_prrSsThresh)
+    { // Proportional rate reduction
+      uint64_t target = (static_cast<uint64_t> (m_prrDelivered) * m_prrSsThresh + m_prrRecoverFs - 1)
+        / std::max (m_prrRecoverFs, 1u);
+      sndcnt = static_cast<int64_t> (target) - prrOut;
+    }
+  else
+    { // Slow start reduction bound
+      int64_t limit = std::max (static_cast<int64_t> (m_prrDelivered) - prrOut,
+                                static_cast<int64_t> (deliveredData)) + m_segmentSize;
+      sndcnt = std::min (static_cast<int64_t> (m_prrSsThresh - pipe), limit);
+    }
+  m_prrSndCnt = static_cast<uint32_t> (std::max (sndcnt, static_cast<int64_t> (0)));
+  m_prrSentMark = m_sentTable.GetBytesSent ();
+  NS_LOG_LOGIC ("PRR delivered " << m_prrDelivered << " out " << prrOut << " pipe " << pipe
+                << " sndcnt " << m_prrSndCnt);
+}
+
 void
 TcpSocketBase::CancelAllTimers ()
 {
@@ -2283,6 +2826,11 @@ TcpSocketBase::CancelAllTimers ()
   m_delAckEvent.Cancel ();
   m_lastAckEvent.Cancel ();
   m_timewaitEvent.Cancel ();
+  if (m_pacingTimer != 0)
+    {
+      m_pacingTimer->Cancel ();
+      m_pacingTimer = 0;
+    }
 }
 
 /* Move TCP to Time_Wait state and schedule a transition to Closed state */
@@ -2422,16 +2970,149 @@ TcpSocketBase::GetAllowBroadcast (void) const
   return false;
 }
 
-/* Placeholder function for future extension that reads more from the TCP header */
+/* Read the options that the peer's AddOptions() attached to the packet as
+   tags. The tags are removed, so that the data stored in the Rx buffer
+   does not carry them further. */
 void
-TcpSocketBase::ReadOptions (const TcpHeader&)
+TcpSocketBase::ReadOptions (Ptr<Packet> packet, const TcpHeader& tcpHeader)
+{
+  TcpSackTag sackTag;
+  TcpWindowScaleTag wsTag;
+  bool hasSack = packet->RemovePacketTag (sackTag);
+  bool hasWs = packet->RemovePacketTag (wsTag);
+  TcpTimestampTag tsTag;
+  bool hasTs = packet->RemovePacketTag (tsTag);
+  m_tsEcrValid = false;
+  if (tcpHeader.GetFlags () & TcpHeader::SYN)
+    { // SACK-permitted option
+      m_sackPermitted = m_sackEnabled && hasSack;
+      NS_LOG_LOGIC (this << " SACK " << (m_sackPermitted ? "permitted" : "not permitted"));
+      // Window scale option, in effect only if both ends sent it
+      m_winScalingPermitted = m_winScalingEnabled && hasWs;
+      if (m_winScalingPermitted)
+        {
+          m_sndWindShift = std::min (wsTag.GetScale (), static_cast<uint8_t> (14));
+          if (!(tcpHeader.GetFlags () & TcpHeader::ACK))
+            { // Passive open: our shift is offered on the SYN+ACK
+              m_rcvWindShift = CalculateWScale ();
+            }
+        }
+      else
+        {
+          m_sndWindShift = 0;
+          m_rcvWindShift = 0;
+        }
+      NS_LOG_LOGIC (this << " window shift " << static_cast<uint32_t> (m_sndWindShift) <<
+                    " received, " << static_cast<uint32_t> (m_rcvWindShift) << " announced");
+      // Timestamps option
+      m_timestampPermitted = m_timestampEnabled && hasTs;
+      if (m_timestampPermitted)
+        {
+          m_tsRecent = tsTag.GetTsval ();
+          m_tsEcr = tsTag.GetTsecr ();
+          m_tsEcrValid = true;
+        }
+    }
+  else if (hasTs && m_timestampPermitted)
+    { // Echo the timestamp of the segments up to the ACK we send next (RFC 7323, sec.4.3)
+      if (tcpHeader.GetSequenceNumber () <= m_lastAckSent
+          && static_cast<int32_t> (tsTag.GetTsval () - m_tsRecent) >= 0)
+        {
+          m_tsRecent = tsTag.GetTsval ();
+        }
+      m_tsEcr = tsTag.GetTsecr ();
+      m_tsEcrValid = true;
+    }
+  if (hasSack && m_sackPermitted && !(tcpHeader.GetFlags () & TcpHeader::SYN)
+      && (tcpHeader.GetFlags () & TcpHeader::ACK))
+    { // Update the scoreboard
+      for (uint8_t i = 0; i < sackTag.GetNBlocks (); ++i)
+        {
+          TcpSackTag::SackBlock block = sackTag.GetBlock (i);
+          m_sentTable.MarkSacked (block.first, block.second);
+        }
+    }
+}
+
+/* TcpHeader does not carry options: they are attached to the packet as
+   tags, and read by ReadOptions() at the peer. */
+void
+TcpSocketBase::AddOptions (TcpHeader& tcpHeader, Ptr<Packet> packet)
 {
+  uint8_t flags = tcpHeader.GetFlags ();
+  if (flags & TcpHeader::ACK)
+    { // Last.ACK.sent, to pick the timestamp to echo (RFC 7323, sec.4.3)
+      m_lastAckSent = tcpHeader.GetAckNumber ();
+    }
+  if (flags & TcpHeader::SYN)
+    { // SYN options are offered on SYN, on SYN+ACK only if the peer offered them
+      bool synAck = flags & TcpHeader::ACK;
+      if (synAck ? m_sackPermitted : m_sackEnabled)
+        {
+          packet->AddPacketTag (TcpSackTag ());
+        }
+      if (synAck ? m_winScalingPermitted : m_winScalingEnabled)
+        {
+          TcpWindowScaleTag wsTag;
+          wsTag.SetScale (m_rcvWindShift);
+          packet->AddPacketTag (wsTag);
+        }
+      if (synAck ? m_timestampPermitted : m_timestampEnabled)
+        {
+          TcpTimestampTag tsTag;
+          tsTag.SetTimestamps (TimestampNow (), synAck ? m_tsRecent : 0);
+          packet->AddPacketTag (tsTag);
+        }
+      return;
+    }
+  if (m_timestampPermitted)
+    {
+      TcpTimestampTag tsTag;
+      tsTag.SetTimestamps (TimestampNow (), m_tsRecent);
+      packet->AddPacketTag (tsTag);
+    }
+  if (m_sackPermitted && (flags & TcpHeader::ACK) && !m_sackBlocks.empty ())
+    {
+      TcpSackTag sackTag;
+      for (std::deque<TcpSackTag::SackBlock>::const_iterator i = m_sackBlocks.begin ();
+           i != m_sackBlocks.end () && sackTag.AddBlock (*i); ++i)
+        {
+        }
+      packet->AddPacketTag (sackTag);
+    }
 }
 
-/* Placeholder function for future extension that changes the TCP header */
+/* Keep the list of out-of-order blocks held in the Rx buffer for the SACK
+   option (RFC 2018, sec.4): the block holding the latest data goes first,
+   and blocks are dropped once cumulatively acknowledged. */
 void
-TcpSocketBase::AddOptions (TcpHeader&)
+TcpSocketBase::UpdateSackBlocks (SequenceNumber32 seq, uint32_t size)
 {
+  NS_LOG_FUNCTION (this << seq << size);
+  SequenceNumber32 next = m_rxBuffer.NextRxSequence ();
+  TcpSackTag::SackBlock block (seq, seq + SequenceNumber32 (size));
+  std::deque<TcpSackTag::SackBlock>::iterator i = m_sackBlocks.begin ();
+  while (i != m_sackBlocks.end ())
+    {
+      if (i->second <= next)
+        { // Acknowledged
+          i = m_sackBlocks.erase (i);
+        }
+      else if (i->first <= block.second && block.first <= i->second)
+        { // Overlapping or adjacent to the new data: merge
+          block.first = std::min (block.first, i->first);
+          block.second = std::max (block.second, i->second);
+          i = m_sackBlocks.erase (i);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+  if (next < block.first)
+    {
+      m_sackBlocks.push_front (block);
+    }
 }
 
 } // namespace ns3
@@ -23,8 +23,10 @@
 
 #include <stdint.h>
 #include <queue>
+#include <deque>
 #include "ns3/callback.h"
 #include "ns3/traced-value.h"
+#include "ns3/traced-callback.h"
 #include "ns3/tcp-socket.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
@@ -33,9 +35,13 @@
 #include "ns3/ipv6-header.h"
 #include "ns3/ipv6-interface.h"
 #include "ns3/event-id.h"
+#include "ns3/data-rate.h"
 #include "tcp-tx-buffer.h"
 #include "tcp-rx-buffer.h"
+#include "tcp-sent-segment-table.h"
+#include "tcp-option-tags.h"
 #include "rtt-estimator.h"
+#include "tcp-pacing-wheel.h"
 
 namespace ns3 {
 
@@ -110,9 +116,47 @@ public:
 
   /**
    * \brief The amount of Rx window announced to the peer
-   * \returns size of Rx window announced to the peer
+   * \param scale apply the negotiated window scale (false on SYN segments)
+   * \returns value of the window field announced to the peer
    */
-  virtual uint16_t AdvertisedWindowSize (void);
+  virtual uint16_t AdvertisedWindowSize (bool scale = true);
+
+  /**
+   * \brief Bound the window advertised to the peer
+   *
+   * The callback is queried on every segment sent, and the window is the
+   * smaller of its result and the free space of the Rx buffer. An
+   * application forwarding the data elsewhere can use it to apply
+   * back-pressure. A null callback removes the bound.
+   *
+   * \param cap returns the largest window to advertise, in bytes
+   */
+  void SetWindowCapCallback (Callback<uint32_t> cap);
+
+  /**
+   * \brief Move received data directly into the Tx buffer of another socket
+   *
+   * The data leaves the Rx buffer as the packet fragments it arrived in and
+   * is queued in dst's Tx buffer as such, without the Packet and socket
+   * address tag Recv () creates for the application, nor a second copy
+   * through Send (). dst sends the data out once, after the move.
+   *
+   * \param dst the socket to forward the data to
+   * \param maxBytes the maximum number of bytes to move
+   * \returns the number of bytes moved, or -1 if dst cannot send (dst's
+   *          errno is then set as Send () would)
+   */
+  int SpliceTo (Ptr<TcpSocketBase> dst, uint32_t maxBytes);
+
+  /**
+   * \brief Reset the connection
+   *
+   * Sends a RST unless the connection is in LISTEN or TIME_WAIT, releases
+   * the end point and moves to CLOSED. The error close callback is invoked.
+   *
+   * \returns 0
+   */
+  int Abort (void);
 
   
   // Necessary implementations of null functions from ns3::Socket
@@ -302,6 +346,26 @@ protected:
    */
   virtual uint32_t SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck);
 
+  /**
+   * \brief Send full segments of new data as one burst
+   *
+   * The data is copied from the TxBuffer, tagged and given its header
+   * once; the segments are fragments of that packet, and the application
+   * is notified once for the whole burst.
+   *
+   * \param seq the sequence number of the first segment
+   * \param segments the number of segments
+   * \param withAck forces an ACK to be sent
+   * \returns the number of bytes sent
+   */
+  uint32_t SendDataBurst (SequenceNumber32 seq, uint32_t segments, bool withAck);
+
+  /**
+   * \brief Add the tags of the socket options set by the application (IP TOS, TTL...)
+   * \param p the packet
+   */
+  void AddSocketTags (Ptr<Packet> p);
+
   /**
    * \brief Send reset and tear down this socket
    */
@@ -467,6 +531,44 @@ protected:
    */
   virtual uint32_t AvailableWindow (void);
 
+  /**
+   * \brief Rate at which segments are released when pacing
+   *
+   * Congestion controllers override it to pace at their own rate; by
+   * default, a window is sent per smoothed RTT, times the PacingGain.
+   *
+   * \returns the pacing rate, 0 if unknown (no RTT sampled yet)
+   */
+  virtual DataRate GetPacingRate (void);
+
+  /**
+   * \brief Rate sending the window once per smoothed RTT, times a gain
+   * \param gain the gain
+   * \returns the rate, 0 if no RTT was sampled yet
+   */
+  DataRate WindowRate (double gain);
+
+  /**
+   * \brief Check whether pacing holds the next segment back
+   *
+   * If it does, the release of the segment is scheduled on the pacing
+   * wheel of the node.
+   *
+   * \returns true if the segment has to wait
+   */
+  bool PacingHold (void);
+
+  /**
+   * \brief Account a segment sent for pacing
+   * \param size the size of the segment
+   */
+  void PacingSent (uint32_t size);
+
+  /**
+   * \brief Release the segments held by pacing
+   */
+  void PacedSend (void);
+
 
   // Manage data tx/rx
 
@@ -492,10 +594,32 @@ protected:
 
   /**
    * \brief Take into account the packet for RTT estimation
+   *
+   * With the timestamps option, every ACK echoing a timestamp gives a
+   * sample, reported by the RttSample trace source; those acknowledging
+   * new data update the estimator and m_lastRtt. Otherwise, the oldest
+   * outstanding segment is timed if it was not retransmitted.
+   *
    * \param tcpHeader the packet's TCP header
    */
   virtual void EstimateRtt (const TcpHeader& tcpHeader);
 
+  /**
+   * \brief Account the data newly acknowledged and take a delivery rate sample
+   *
+   * Called on a new ACK, before NewAck (), so that congestion controls
+   * overriding NewAck () find the sample in m_rateSample. Samples over an
+   * interval shorter than the lowest RTT seen are discarded.
+   *
+   * \param ack the cumulative acknowledgement number
+   */
+  void SampleDeliveryRate (SequenceNumber32 ack);
+
+  /**
+   * \brief Note that the application does not fill the window, if so
+   */
+  void CheckAppLimited (void);
+
   /**
    * \brief Update buffers w.r.t. ACK
    * \param seq the sequence number
@@ -539,17 +663,72 @@ protected:
    */
   virtual void DoRetransmit (void);
 
+  /**
+   * \brief Retransmit the oldest packet upon duplicate ACKs
+   *
+   * If SACK was negotiated, this also enters RFC 6675 loss recovery:
+   * until the data outstanding now is acknowledged, SendPendingData ()
+   * retransmits the segments the scoreboard deems lost and limits the
+   * data in flight by the pipe estimate instead of the unacked count.
+   */
+  void FastRetransmit (void);
+
+  /**
+   * \brief Start a proportional rate reduction (RFC 6937) of the data in flight
+   *
+   * For the congestion controls supporting PRR, when the Prr attribute is
+   * set: called on entering fast recovery, before FastRetransmit (). Until
+   * PrrStop (), the data sent on each ACK is proportional to the data
+   * delivered, so that the data in flight goes down to ssThresh by the end
+   * of the recovery. AvailableWindow () then ignores the congestion window.
+   *
+   * \param ssThresh window to reach at the end of the recovery
+   */
+  void PrrStart (uint32_t ssThresh);
+
+  /**
+   * \brief End the rate reduction, the congestion window takes over again
+   */
+  void PrrStop (void);
+
+  /**
+   * \brief Account the data delivered by an ACK and set the PRR send quota
+   */
+  void PrrUpdate (void);
+
   /**
    * \brief Read option from incoming packets
+   * \param packet the packet, carrying the options as tags
    * \param tcpHeader the packet's TCP header
    */
-  virtual void ReadOptions (const TcpHeader& tcpHeader);
+  virtual void ReadOptions (Ptr<Packet> packet, const TcpHeader& tcpHeader);
 
   /**
    * \brief Add option to outgoing packets
    * \param tcpHeader the packet's TCP header
+   * \param packet the packet, to which the options are added as tags
    */
-  virtual void AddOptions (TcpHeader& tcpHeader);
+  virtual void AddOptions (TcpHeader& tcpHeader, Ptr<Packet> packet);
+
+  /**
+   * \brief Update the SACK blocks with newly received data
+   * \param seq first sequence number of the data
+   * \param size size of the data
+   */
+  void UpdateSackBlocks (SequenceNumber32 seq, uint32_t size);
+
+  /**
+   * \brief Window scale shift to offer, so that the Rx buffer can be
+   *        announced in full (RFC 7323, sec.2.3)
+   * \returns the shift count
+   */
+  uint8_t CalculateWScale (void) const;
+
+  /**
+   * \brief Current value of the timestamps option clock
+   * \returns the time, in microseconds, truncated to 32 bits
+   */
+  static uint32_t TimestampNow (void);
 
 
 protected:
@@ -578,6 +757,7 @@ protected:
   Ptr<TcpL4Protocol>  m_tcp;        //!< the associated TCP L4 protocol
   Callback<void, Ipv4Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback;  //!< ICMP callback
   Callback<void, Ipv6Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback6; //!< ICMPv6 callback
+  Callback<uint32_t> m_windowCap; //!< Bound on the advertised window, if not null
 
   Ptr<RttEstimator> m_rtt; //!< Round trip time estimator
 
@@ -586,6 +766,7 @@ protected:
   TracedValue<SequenceNumber32> m_highTxMark;     //!< Highest seqno ever sent, regardless of ReTx
   TcpRxBuffer                   m_rxBuffer;       //!< Rx buffer (reordering buffer)
   TcpTxBuffer                   m_txBuffer;       //!< Tx buffer
+  TcpSentSegmentTable           m_sentTable;      //!< Send state of outstanding segments
 
   // State-related attributes
   TracedValue<TcpStates_t> m_state;         //!< TCP state
@@ -599,8 +780,56 @@ protected:
 
   // Window management
   uint32_t              m_segmentSize; //!< Segment size
-  uint16_t              m_maxWinSize;  //!< Maximum window size to advertise
+  uint32_t              m_maxWinSize;  //!< Maximum window size to advertise
+  uint32_t              m_offloadSize; //!< Largest burst of new data sent at once, 0 for none
   TracedValue<uint32_t> m_rWnd;        //!< Flow control window at remote side
+
+  // Pacing
+  bool                  m_pacing;        //!< Release segments at the pacing rate
+  double                m_pacingGain;    //!< Gain of the default pacing rate over cwnd / srtt
+  Time                  m_nextPacedSend; //!< Earliest time the next segment may leave
+  Ptr<TcpPacingWheel::Timer> m_pacingTimer; //!< Release of the held segments, if any
+
+  // Delivery rate estimation (draft-cheng-iccrg-delivery-rate-estimation)
+  TcpRateSample         m_rateSample;    //!< Sample of the last new ACK, zero interval if none
+  DataRate              m_deliveryRate;  //!< Rate of the last valid sample
+  Time                  m_lowestRtt;     //!< Lowest RTT sampled, the shortest valid sample interval
+  TracedCallback<DataRate, bool> m_deliveryRateTrace; //!< Rate and application limited flag of every sample
+
+  // Window scaling (RFC 7323)
+  bool                  m_winScalingEnabled;   //!< Offer window scaling on connection setup
+  bool                  m_winScalingPermitted; //!< Window scaling negotiated with the peer
+  uint8_t               m_sndWindShift;        //!< Shift applied to the windows received
+  uint8_t               m_rcvWindShift;        //!< Shift applied to the windows announced
+
+  // Timestamps (RFC 7323)
+  bool                  m_timestampEnabled;   //!< Offer timestamps on connection setup
+  bool                  m_timestampPermitted; //!< Timestamps negotiated with the peer
+  uint32_t              m_tsRecent;           //!< TS.Recent, the timestamp to echo
+  uint32_t              m_tsEcr;              //!< Timestamp echoed by the last segment received
+  bool                  m_tsEcrValid;         //!< The last segment received carried a timestamp
+  SequenceNumber32      m_lastAckSent;        //!< Last.ACK.sent, the ACK number of the last segment sent
+  TracedCallback<Time>  m_rttSample;          //!< RTT of every ACK echoing a timestamp
+
+  // Selective acknowledgement (RFC 2018, RFC 6675)
+  bool                  m_sackEnabled;   //!< Offer SACK on connection setup
+  bool                  m_sackPermitted; //!< SACK negotiated with the peer
+  std::deque<TcpSackTag::SackBlock> m_sackBlocks; //!< Out-of-order data held, most recent first
+  bool                  m_sackRecovery;  //!< In SACK based loss recovery
+  SequenceNumber32      m_recoveryPoint; //!< Highest seqno sent when recovery started
+  SequenceNumber32      m_highRxt;       //!< Highest seqno retransmitted in the recovery
+
+  // Proportional rate reduction (RFC 6937)
+  bool                  m_prr;           //!< Fast recovery uses PRR, if the congestion control supports it
+  bool                  m_prrActive;     //!< A rate reduction is in progress
+  uint32_t              m_prrSsThresh;   //!< Data in flight to reach at the end of the recovery
+  uint32_t              m_prrRecoverFs;  //!< RecoverFS, the data in flight when the recovery started
+  uint32_t              m_prrStart;      //!< Delivered and SACKed bytes when the recovery started
+  uint32_t              m_prrSentStart;  //!< Bytes sent counter when the recovery started
+  uint32_t              m_prrDupBytes;   //!< Bytes delivered by the dupacks since the last new ACK, without SACK
+  uint32_t              m_prrDelivered;  //!< prr_delivered, bytes delivered since the recovery started
+  uint32_t              m_prrSndCnt;     //!< Bytes the last ACK allows to send
+  uint32_t              m_prrSentMark;   //!< Bytes sent counter at the last ACK
 };
 
 } // namespace ns3